@@ -0,0 +1,107 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Scaling of the lock-free concurrent_disjoint_set, uniting a random edge list with 1 up
+// to the number of hardware threads, every thread unites a contiguous slice of the edges.
+// The single threaded dynamic_disjoint_set is the baseline.
+
+#include <cstdint>
+#include <cstdlib>
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <plf/plf_nanotimer.h>
+
+#include "concurrent_disjoint_set.hpp"
+#include "disjoint_set.hpp"
+
+using size_type = std::uint32_t;
+using edge_type = std::pair<size_type, size_type>;
+
+constexpr size_type elements = 1 << 22;
+constexpr std::size_t edges  = std::size_t{ 1 } << 24;
+
+[[nodiscard]] std::vector<edge_type> make_edges ( ) {
+    std::mt19937 rng{ 42 };
+    std::uniform_int_distribution<size_type> element ( 0, elements - 1 );
+    std::vector<edge_type> e ( edges );
+    for ( edge_type & x : e )
+        x = { element ( rng ), element ( rng ) };
+    return e;
+}
+
+[[nodiscard]] double bench_sequential ( std::vector<edge_type> const & edges_, std::size_t & groups_ ) {
+    dynamic_disjoint_set<size_type> s ( elements );
+    plf::nanotimer timer;
+    timer.start ( );
+    for ( auto const & [ a, b ] : edges_ )
+        s.unite ( a, b );
+    double const t = timer.get_elapsed_ms ( );
+    groups_        = s.group_count ( );
+    return t;
+}
+
+[[nodiscard]] double bench_concurrent ( std::vector<edge_type> const & edges_, unsigned threads_, std::size_t & groups_ ) {
+    concurrent_disjoint_set<size_type> s ( elements );
+    std::vector<std::thread> threads;
+    threads.reserve ( threads_ );
+    plf::nanotimer timer;
+    timer.start ( );
+    for ( unsigned t = 0; t < threads_; ++t )
+        threads.emplace_back ( [ &, t ] {
+            std::size_t const first = edges_.size ( ) * t / threads_, last = edges_.size ( ) * ( t + 1 ) / threads_;
+            for ( std::size_t e = first; e < last; ++e )
+                s.unite ( edges_[ e ].first, edges_[ e ].second );
+        } );
+    for ( std::thread & t : threads )
+        t.join ( );
+    double const t = timer.get_elapsed_ms ( );
+    groups_        = 0;
+    for ( size_type x = 0; x < elements; ++x )
+        groups_ += s.find ( x ) == x;
+    return t;
+}
+
+int main ( ) {
+    std::vector<edge_type> const e = make_edges ( );
+    unsigned const max_threads     = std::max ( 1u, std::thread::hardware_concurrency ( ) );
+    std::size_t groups = 0, check = 0;
+    double const base = bench_sequential ( e, check );
+    std::cout << "threads        ms   Medges/s   speed-up\n" << std::fixed << std::setprecision ( 2 );
+    std::cout << "    seq" << std::setw ( 10 ) << base << std::setw ( 11 ) << edges / base / 1'000.0 << std::setw ( 11 ) << 1.0
+              << '\n';
+    for ( unsigned n = 1; n <= max_threads; n *= 2 ) {
+        double const t = bench_concurrent ( e, n, groups );
+        if ( groups != check )
+            return EXIT_FAILURE;
+        std::cout << std::setw ( 7 ) << n << std::setw ( 10 ) << t << std::setw ( 11 ) << edges / t / 1'000.0 << std::setw ( 11 )
+                  << base / t << '\n';
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,100 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Multi-threaded push/pop throughput, every thread owns one stack (branch). The
+// concurrent_spaghetti_stack is compared to a spaghetti_stack behind a mutex.
+
+#include <cstdint>
+#include <cstdlib>
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <plf/plf_nanotimer.h>
+
+#include "concurrent_spaghetti_stack.hpp"
+#include "spaghetti_stack.hpp"
+
+using size_type = std::uint32_t;
+
+constexpr int pushes_per_thread = 1 << 20;
+constexpr int pops_every        = 4; // Pop one value after every pops_every pushes.
+
+template<typename Work>
+[[nodiscard]] double run_threads ( int n_, Work && work_ ) {
+    std::vector<std::thread> threads;
+    threads.reserve ( n_ );
+    plf::nanotimer timer;
+    timer.start ( );
+    for ( int t = 0; t < n_; ++t )
+        threads.emplace_back ( work_, t );
+    for ( std::thread & t : threads )
+        t.join ( );
+    return timer.get_elapsed_ns ( );
+}
+
+[[nodiscard]] double bench_concurrent ( int n_ ) {
+    concurrent_spaghetti_stack<std::uint64_t, size_type> s;
+    return run_threads ( n_, [ &s ] ( int t_ ) {
+        size_type const i = s.notch_push ( t_ ).second;
+        for ( int p = 1; p < pushes_per_thread; ++p ) {
+            s.push ( i, p );
+            if ( not( p % pops_every ) )
+                s.pop ( i );
+        }
+    } );
+}
+
+[[nodiscard]] double bench_locked ( int n_ ) {
+    spaghetti_stack<std::uint64_t, size_type> s;
+    std::mutex mutex;
+    return run_threads ( n_, [ &s, &mutex ] ( int t_ ) {
+        size_type i;
+        {
+            std::scoped_lock lock ( mutex );
+            i = s.notch_push ( t_ ).second;
+        }
+        for ( int p = 1; p < pushes_per_thread; ++p ) {
+            std::scoped_lock lock ( mutex );
+            s.push ( i, p );
+            if ( not( p % pops_every ) )
+                s.pop ( i );
+        }
+    } );
+}
+
+int main ( ) {
+    int const max_threads = static_cast<int> ( std::max ( 1u, std::thread::hardware_concurrency ( ) ) );
+    std::cout << "threads     locked Mops/s     concurrent Mops/s\n";
+    for ( int n = 1; n <= max_threads; n *= 2 ) {
+        double const ops = static_cast<double> ( n ) * ( pushes_per_thread + pushes_per_thread / pops_every );
+        double const l = bench_locked ( n ), c = bench_concurrent ( n );
+        std::cout << std::setw ( 7 ) << n << std::fixed << std::setprecision ( 2 ) << std::setw ( 19 ) << ops * 1'000.0 / l
+                  << std::setw ( 22 ) << ops * 1'000.0 / c << '\n';
+    }
+    return EXIT_SUCCESS;
+}
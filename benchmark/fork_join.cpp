@@ -0,0 +1,112 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Fork-join speed-up of the work-stealing runtime, on fib (a join per call, down to a
+// small cutoff) and on the sum of the values of a tree (a spaghetti_stack, a join per
+// child), with 1 up to the number of hardware threads.
+
+#include <cstdint>
+#include <cstdlib>
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <plf/plf_nanotimer.h>
+
+#include "fork_join.hpp"
+#include "spaghetti_stack.hpp"
+
+using size_type = std::uint32_t;
+using tree_type = spaghetti_stack<std::uint64_t, size_type>;
+
+constexpr int fib_n = 34, fib_cutoff = 12;
+constexpr size_type tree_nodes = 1 << 22;
+
+[[nodiscard]] std::uint64_t fib ( int n_ ) {
+    if ( n_ < fib_cutoff )
+        return n_ < 2 ? n_ : fib ( n_ - 1 ) + fib ( n_ - 2 );
+    std::uint64_t a, b;
+    fork_join_pool::join ( [ & ] { a = fib ( n_ - 1 ); }, [ & ] { b = fib ( n_ - 2 ); } );
+    return a + b;
+}
+
+[[nodiscard]] std::uint64_t tree_sum ( tree_type const & t_, size_type n_ );
+
+// The sum of the subtrees of child c_ and of its next siblings.
+[[nodiscard]] std::uint64_t siblings_sum ( tree_type const & t_, size_type c_ ) {
+    if ( tree_type::nil == c_ )
+        return 0;
+    std::uint64_t a, b;
+    fork_join_pool::join ( [ & ] { a = tree_sum ( t_, c_ ); }, [ & ] { b = siblings_sum ( t_, t_.next_sibling ( c_ ) ); } );
+    return a + b;
+}
+
+[[nodiscard]] std::uint64_t tree_sum ( tree_type const & t_, size_type n_ ) {
+    return t_.value ( n_ ) + siblings_sum ( t_, t_.find_child ( n_ ) );
+}
+
+// A random recursive tree, the parent of node n is drawn from the nodes before it.
+[[nodiscard]] tree_type make_tree ( ) {
+    std::mt19937 rng{ 42 };
+    std::vector<size_type> parents ( tree_nodes );
+    std::vector<std::uint64_t> values ( tree_nodes );
+    for ( size_type n = 0; n < tree_nodes; ++n ) {
+        parents[ n ] = n ? static_cast<size_type> ( rng ( ) % n ) : tree_type::nil;
+        values[ n ]  = rng ( ) % 1'000;
+    }
+    tree_type t;
+    t.bulk_load ( parents, values );
+    return t;
+}
+
+template<typename F>
+[[nodiscard]] double measure ( fork_join_pool & pool_, F && f_, std::uint64_t & result_ ) {
+    plf::nanotimer timer;
+    timer.start ( );
+    result_ = pool_.run ( f_ );
+    return timer.get_elapsed_ms ( );
+}
+
+int main ( ) {
+    tree_type const tree = make_tree ( );
+    unsigned const max_threads = std::max ( 1u, std::thread::hardware_concurrency ( ) );
+    std::uint64_t fib_result = 0, sum_result = 0, check = 0;
+    std::cout << "threads     fib ms   speed-up    tree-sum ms   speed-up\n";
+    double fib_1 = 0, sum_1 = 0;
+    for ( unsigned n = 1; n <= max_threads; n *= 2 ) {
+        fork_join_pool pool ( n );
+        double const f = measure ( pool, [] { return fib ( fib_n ); }, fib_result );
+        double const s = measure ( pool, [ & ] { return tree_sum ( tree, 0 ); }, sum_result );
+        if ( 1 == n )
+            fib_1 = f, sum_1 = s, check = fib_result ^ sum_result;
+        else if ( check != ( fib_result ^ sum_result ) )
+            return EXIT_FAILURE;
+        std::cout << std::setw ( 7 ) << n << std::fixed << std::setprecision ( 2 ) << std::setw ( 11 ) << f << std::setw ( 11 )
+                  << fib_1 / f << std::setw ( 15 ) << s << std::setw ( 11 ) << sum_1 / s << '\n';
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,183 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// The three layouts of the notes in main.cpp, (A) heap, (B) cactus and (C) spaghetti,
+// on three workloads. Peak rss is a per-process high-water mark, so every row (a layout
+// on a workload) is measured in a process of its own, the benchmark starts itself once per
+// row. Pass a layout (A, B or C) on the command line to measure that layout only.
+
+#include <cstdint>
+#include <cstdlib>
+
+#include <array>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+#if defined( _WIN32 )
+#    ifndef NOMINMAX
+#        define NOMINMAX
+#    endif
+#    include <Windows.h>
+#    include <Psapi.h>
+#else
+#    include <sys/resource.h>
+#endif
+
+#include <plf/plf_nanotimer.h>
+
+#include "spaghetti_stack.hpp"
+
+using size_type = std::uint32_t;
+
+struct payload {
+    std::uint64_t a = 0, b = 0, c = 0;
+};
+
+[[nodiscard]] std::size_t peak_rss_kb ( ) noexcept {
+#if defined( _WIN32 )
+    PROCESS_MEMORY_COUNTERS pmc;
+    GetProcessMemoryInfo ( GetCurrentProcess ( ), &pmc, sizeof ( pmc ) );
+    return pmc.PeakWorkingSetSize / 1'024;
+#else
+    rusage ru;
+    getrusage ( RUSAGE_SELF, &ru );
+    return static_cast<std::size_t> ( ru.ru_maxrss );
+#endif
+}
+
+std::uint64_t sink = 0;
+
+// Deep linear recursion, push a long chain onto one stack and unwind it.
+template<typename Stack>
+[[nodiscard]] std::size_t deep_recursion ( ) {
+    constexpr int depth = 1 << 20, rounds = 8;
+    Stack s;
+    size_type const i = s.notch_emplace ( payload{ } ).second;
+    for ( int r = 0; r < rounds; ++r ) {
+        for ( std::uint64_t d = 1; d < depth; ++d )
+            s.emplace ( i, payload{ d, d, d } );
+        for ( int d = 1; d < depth; ++d )
+            sink += s.pop ( i ).a;
+    }
+    return std::size_t{ 2 } * rounds * ( depth - 1 );
+}
+
+// Wide fan-out, many stacks forked off one root, each a few frames deep, all alive at once,
+// removed in the order they were created. The width stays below the number of regions the
+// cactus layout can address with a 32-bit index.
+template<typename Stack>
+[[nodiscard]] std::size_t wide_fan_out ( ) {
+    constexpr int width = 4'000, frames = 64, rounds = 64;
+    Stack s;
+    size_type const root = s.notch_emplace ( payload{ } ).second;
+    for ( int r = 0; r < rounds; ++r ) {
+        for ( std::uint64_t w = 0; w < width; ++w ) {
+            size_type const i = s.fork_emplace ( root, payload{ w } ).second;
+            for ( std::uint64_t f = 1; f < frames; ++f )
+                s.emplace ( i, payload{ w, f } );
+        }
+        for ( size_type i = 1; i <= width; ++i )
+            s.remove_stack ( i );
+    }
+    return std::size_t{ rounds } * width * ( frames + 1 );
+}
+
+// Many small, short-lived stacks, forked, used and removed, interleaved with a longer-lived stack.
+template<typename Stack>
+[[nodiscard]] std::size_t short_lived ( ) {
+    constexpr int count = 1 << 20, frames = 4;
+    Stack s;
+    size_type const root = s.notch_emplace ( payload{ } ).second;
+    for ( std::uint64_t c = 0; c < count; ++c ) {
+        size_type const i = s.fork_emplace ( root, payload{ c } ).second;
+        for ( std::uint64_t f = 1; f < frames; ++f )
+            s.emplace ( i, payload{ c, f } );
+        for ( int f = 1; f < frames; ++f )
+            sink += s.pop ( i ).b;
+        s.remove_stack ( i );
+        if ( not( c & 7 ) )
+            s.emplace ( root, payload{ c } );
+    }
+    return std::size_t{ count } * ( 2 * frames );
+}
+
+constexpr std::array<std::string_view, 3> workloads = { "deep", "fan-out", "short-lived" };
+
+// Measures one row, workload_ on the layout Stack, returns false for an unknown workload.
+template<typename Stack>
+[[nodiscard]] bool run ( std::string_view name_, std::string_view workload_ ) {
+    auto const measure = [ name_, workload_ ] ( auto && f_ ) {
+        plf::nanotimer timer;
+        timer.start ( );
+        std::size_t const ops = f_ ( );
+        double const ns       = timer.get_elapsed_ns ( );
+        std::cout << std::setw ( 14 ) << name_ << std::setw ( 16 ) << workload_ << std::fixed << std::setprecision ( 2 )
+                  << std::setw ( 12 ) << ns / static_cast<double> ( ops ) << std::setw ( 16 ) << peak_rss_kb ( ) << '\n';
+    };
+    if ( workloads[ 0 ] == workload_ )
+        measure ( deep_recursion<Stack> );
+    else if ( workloads[ 1 ] == workload_ )
+        measure ( wide_fan_out<Stack> );
+    else if ( workloads[ 2 ] == workload_ )
+        measure ( short_lived<Stack> );
+    else
+        return false;
+    return true;
+}
+
+[[nodiscard]] bool run ( char layout_, std::string_view workload_ ) {
+    switch ( layout_ ) {
+        case 'A': return run<heap_stack<payload, size_type>> ( "(A) heap", workload_ );
+        case 'B': return run<cactus_stack<payload, size_type>> ( "(B) cactus", workload_ );
+        case 'C': return run<spaghetti_stack<payload, size_type>> ( "(C) spaghetti", workload_ );
+        default: return false;
+    }
+}
+
+int main ( int argc, char ** argv ) {
+    // A row, in the process started for it below.
+    if ( argc > 2 ) {
+        if ( not run ( argv[ 1 ][ 0 ], argv[ 2 ] ) )
+            return EXIT_FAILURE;
+        std::uint64_t volatile observed = sink; // Keeps the workloads from being optimized out.
+        static_cast<void> ( observed );
+        return EXIT_SUCCESS;
+    }
+    char const layout = argc > 1 ? argv[ 1 ][ 0 ] : '*';
+    std::cout << "        layout        workload       ns/op    peak rss (kb)" << std::endl;
+    int failed = 0;
+    for ( char const l : { 'A', 'B', 'C' } ) {
+        if ( '*' != layout and l != layout )
+            continue;
+        for ( std::string_view const w : workloads ) {
+            std::string command = '"' + std::string{ argv[ 0 ] } + "\" " + l + ' ' + std::string{ w };
+#if defined( _WIN32 )
+            command = '"' + command + '"'; // cmd /c strips the outer quotes.
+#endif
+            failed |= std::system ( command.c_str ( ) );
+        }
+    }
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
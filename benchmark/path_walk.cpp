@@ -0,0 +1,99 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Path-walk throughput, from the tail of every stack down to its root, following prev
+// only, of the array-of-structs (nodes hold their value) and the struct-of-arrays (values
+// in an array of their own) layouts, for a number of value sizes.
+
+#include <cstdint>
+#include <cstdlib>
+
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+#include <plf/plf_nanotimer.h>
+
+#include "spaghetti_stack.hpp"
+
+using size_type = std::uint32_t;
+
+template<std::size_t Size>
+struct payload {
+    std::uint64_t data[ Size / sizeof ( std::uint64_t ) ] = { };
+};
+
+constexpr int nodes = 1 << 18, walks = 8;
+
+std::uint64_t sink = 0;
+
+// A random tree, stacks are pushed onto and forked off at random.
+template<typename Stack>
+void grow ( Stack & s_ ) {
+    using value_type = typename Stack::value_type;
+    std::mt19937 rng{ 42 };
+    s_.notch_emplace ( value_type{ } );
+    for ( int n = 1; n < nodes; ++n ) {
+        size_type const i = static_cast<size_type> ( rng ( ) % s_.size ( ) );
+        if ( rng ( ) % 16 )
+            s_.emplace ( i, value_type{ } );
+        else
+            s_.fork_emplace ( i, value_type{ } );
+    }
+}
+
+// Returns ns per step.
+template<typename Stack>
+[[nodiscard]] double walk ( Stack const & s_ ) {
+    std::uint64_t steps = 0;
+    plf::nanotimer timer;
+    timer.start ( );
+    for ( int w = 0; w < walks; ++w ) {
+        for ( size_type i = 0; i < s_.size ( ); ++i ) {
+            for ( size_type n = s_.tail ( i ); n != Stack::nil; n = s_.prev ( n ) ) {
+                sink += n;
+                ++steps;
+            }
+        }
+    }
+    return timer.get_elapsed_ns ( ) / static_cast<double> ( steps );
+}
+
+template<std::size_t Size>
+void run ( ) {
+    spaghetti_stack<payload<Size>, size_type> aos;
+    soa_spaghetti_stack<payload<Size>, size_type> soa;
+    grow ( aos );
+    grow ( soa );
+    double const a = walk ( aos ), s = walk ( soa );
+    std::cout << std::setw ( 10 ) << Size << std::fixed << std::setprecision ( 2 ) << std::setw ( 14 ) << a << std::setw ( 14 ) << s
+              << '\n';
+}
+
+int main ( ) {
+    std::cout << "value (b)    aos ns/step   soa ns/step\n";
+    run<8> ( );
+    run<64> ( );
+    run<256> ( );
+    return static_cast<int> ( sink & 1 );
+}
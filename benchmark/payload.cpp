@@ -0,0 +1,109 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Push/pop round trips of a 256-byte payload: pushing a copy and popping by value, pushing
+// a moved value and popping by value (a move out of the released node), and emplacing in
+// place and consuming the value through visit_pop. The last one also with a move-only
+// payload (that owns a buffer on the heap).
+
+#include <cstdint>
+#include <cstdlib>
+
+#include <array>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+
+#include <plf/plf_nanotimer.h>
+
+#include "spaghetti_stack.hpp"
+
+using size_type = std::uint32_t;
+
+constexpr int round_trips = 1 << 22;
+constexpr int depth       = 64; // The stack is kept at this depth, every round trip pushes and pops one value.
+
+struct payload {
+    payload ( ) noexcept = default;
+    explicit payload ( std::uint64_t w_ ) noexcept { words.fill ( w_ ); }
+
+    std::array<std::uint64_t, 32> words;
+};
+
+struct move_only_payload {
+    move_only_payload ( ) noexcept = default;
+    explicit move_only_payload ( std::uint64_t w_ ) : buffer{ std::make_unique<std::uint64_t> ( w_ ) } { words.fill ( w_ ); }
+
+    std::array<std::uint64_t, 31> words;
+    std::unique_ptr<std::uint64_t> buffer;
+};
+
+static_assert ( sizeof ( payload ) == 256 and sizeof ( move_only_payload ) == 256 );
+
+template<typename Payload, typename RoundTrip>
+[[nodiscard]] double measure ( RoundTrip && round_trip_, std::uint64_t & sum_ ) {
+    spaghetti_stack<Payload, size_type> s;
+    size_type const i = s.notch_emplace ( ).second;
+    for ( int d = 1; d < depth; ++d )
+        s.emplace ( i );
+    plf::nanotimer timer;
+    timer.start ( );
+    for ( int r = 0; r < round_trips; ++r )
+        sum_ += round_trip_ ( s, i, static_cast<std::uint64_t> ( r ) );
+    return timer.get_elapsed_ns ( ) / round_trips;
+}
+
+int main ( ) {
+    std::uint64_t sum = 0;
+    double const copy = measure<payload> (
+        [] ( auto & s_, size_type i_, std::uint64_t r_ ) {
+            payload const p ( r_ );
+            s_.push ( i_, p );
+            return s_.pop ( i_ ).words[ 7 ];
+        },
+        sum );
+    double const move = measure<payload> (
+        [] ( auto & s_, size_type i_, std::uint64_t r_ ) {
+            s_.push ( i_, payload ( r_ ) );
+            return s_.pop ( i_ ).words[ 7 ];
+        },
+        sum );
+    double const in_place = measure<payload> (
+        [] ( auto & s_, size_type i_, std::uint64_t r_ ) {
+            s_.emplace ( i_, r_ );
+            return s_.visit_pop ( i_, [] ( payload const & p_ ) { return p_.words[ 7 ]; } );
+        },
+        sum );
+    double const move_only = measure<move_only_payload> (
+        [] ( auto & s_, size_type i_, std::uint64_t r_ ) {
+            s_.emplace ( i_, r_ );
+            return s_.visit_pop ( i_, [] ( move_only_payload & p_ ) { return p_.words[ 7 ] + *p_.buffer; } );
+        },
+        sum );
+    std::cout << "round trip              ns\n" << std::fixed << std::setprecision ( 2 );
+    std::cout << "push copy, pop   " << std::setw ( 11 ) << copy << '\n';
+    std::cout << "push move, pop   " << std::setw ( 11 ) << move << '\n';
+    std::cout << "emplace, visit   " << std::setw ( 11 ) << in_place << '\n';
+    std::cout << "move-only, visit " << std::setw ( 11 ) << move_only << '\n';
+    return sum ? EXIT_SUCCESS : EXIT_FAILURE;
+}
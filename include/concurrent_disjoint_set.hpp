@@ -0,0 +1,108 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+#include <atomic>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+// A disjoint set (union-find) that many threads can unite and query at once, lock-free. The
+// parents are an array of atomic indices. unite ( ) links the root of the higher index below
+// the other root, with a cas on the parent of the root, which fails if that root got linked
+// in the meantime, the two finds are then retried. As the links always go from a higher to a
+// lower index, no cycles can form, and the root of a group is its lowest element. find ( )
+// does path splitting, every node on the path is swung to its grandparent with a cas, a
+// failed cas only means another thread got there first. The set has a fixed size.
+template<typename SizeType = std::uint32_t>
+struct concurrent_disjoint_set {
+
+    using size_type = SizeType;
+
+    static_assert ( std::is_unsigned_v<size_type>, "indices must be unsigned" );
+
+    // Not an element.
+    static constexpr size_type nil = static_cast<size_type> ( -1 );
+
+    // A set of size_ elements, every element a group of its own.
+    explicit concurrent_disjoint_set ( size_type size_ ) :
+        parent{ std::make_unique<std::atomic<size_type>[]> ( size_ ) }, elements{ size_ } {
+        assert ( nil != size_ );
+        for ( size_type x = 0; x < size_; ++x )
+            parent[ x ].store ( x, std::memory_order_relaxed );
+    }
+
+    concurrent_disjoint_set ( concurrent_disjoint_set const & ) = delete;
+    concurrent_disjoint_set & operator= ( concurrent_disjoint_set const & ) = delete;
+
+    // Returns the root of the group of x_, at some point during the call.
+    [[nodiscard]] size_type find ( size_type x_ ) noexcept {
+        assert ( x_ < size ( ) );
+        for ( ;; ) {
+            size_type p       = parent[ x_ ].load ( std::memory_order_acquire );
+            size_type const g = parent[ p ].load ( std::memory_order_acquire );
+            if ( p == g )
+                return p;
+            parent[ x_ ].compare_exchange_weak ( p, g, std::memory_order_release, std::memory_order_relaxed );
+            x_ = p;
+        }
+    }
+
+    // Unites the groups of a_ and b_, returns false if they were united already.
+    [[maybe_unused]] bool unite ( size_type a_, size_type b_ ) noexcept {
+        for ( ;; ) {
+            a_ = find ( a_ ), b_ = find ( b_ );
+            if ( a_ == b_ )
+                return false;
+            if ( a_ < b_ )
+                std::swap ( a_, b_ );
+            size_type root = a_;
+            if ( parent[ a_ ].compare_exchange_strong ( root, b_, std::memory_order_acq_rel, std::memory_order_relaxed ) )
+                return true;
+        }
+    }
+
+    // Returns true if a_ and b_ are in the same group. Without concurrent unites of their
+    // groups, the answer is exact, otherwise it's the state at some point during the call.
+    [[nodiscard]] bool same ( size_type a_, size_type b_ ) noexcept {
+        for ( ;; ) {
+            a_ = find ( a_ ), b_ = find ( b_ );
+            if ( a_ == b_ )
+                return true;
+            if ( parent[ a_ ].load ( std::memory_order_acquire ) == a_ )
+                return false;
+        }
+    }
+
+    // The number of elements.
+    [[nodiscard]] size_type size ( ) const noexcept { return elements; }
+
+    private:
+    std::unique_ptr<std::atomic<size_type>[]> parent;
+    size_type elements;
+};
@@ -0,0 +1,316 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include <sax/stl.hpp>
+
+#include "spaghetti_storage.hpp"
+
+// A chunked array, of which the chunk directory is allocated up-front, with a capacity of
+// 2^(DirectoryShift + ChunkShift) elements. Chunks are allocated on first use and installed
+// with a cas, the directory itself never moves, so it can be indexed without locking. A
+// chunk carries a bitmap of the slots that hold a constructed element, a slot is marked
+// (with release semantics) once its element is constructed, the elements are destroyed with
+// the array. A slot of which the construction threw stays unmarked.
+template<typename T, typename S, std::size_t ChunkShift = 12, std::size_t DirectoryShift = 16,
+         typename Allocator = xmi_stl_allocator<T>>
+struct concurrent_chunked_array {
+
+    using value_type     = T;
+    using size_type      = S;
+    using allocator_type = Allocator;
+
+    using pointer         = value_type *;
+    using reference       = value_type &;
+    using const_reference = value_type const &;
+
+    static constexpr size_type chunk_shift      = static_cast<size_type> ( ChunkShift );
+    static constexpr size_type chunk_size       = size_type{ 1 } << chunk_shift;
+    static constexpr size_type chunk_mask       = chunk_size - 1;
+    static constexpr std::size_t directory_size = std::size_t{ 1 } << DirectoryShift;
+    static constexpr std::size_t capacity       = directory_size << ChunkShift;
+
+    static_assert ( ChunkShift >= 6, "a chunk holds at least one word of the bitmap" );
+
+    private:
+    struct chunk_type {
+        std::atomic<std::uint64_t> constructed[ chunk_size >> 6 ] = { };
+        alignas ( value_type ) unsigned char storage[ chunk_size * sizeof ( value_type ) ];
+
+        [[nodiscard]] pointer at ( size_type i_ ) noexcept {
+            return std::launder ( reinterpret_cast<pointer> ( storage ) + ( i_ & chunk_mask ) );
+        }
+        [[nodiscard]] bool contains ( size_type i_ ) const noexcept {
+            return constructed[ ( i_ & chunk_mask ) >> 6 ].load ( std::memory_order_acquire ) >> ( i_ & 63 ) & 1;
+        }
+    };
+
+    using chunk_allocator = typename std::allocator_traits<allocator_type>::template rebind_alloc<chunk_type>;
+
+    public:
+    concurrent_chunked_array ( ) : chunks{ std::make_unique<std::atomic<chunk_type *>[]> ( directory_size ) } {
+        for ( std::size_t c = 0; c < directory_size; ++c )
+            chunks[ c ].store ( nullptr, std::memory_order_relaxed );
+    }
+    concurrent_chunked_array ( concurrent_chunked_array const & ) = delete;
+    concurrent_chunked_array ( concurrent_chunked_array && )      = delete;
+
+    ~concurrent_chunked_array ( ) noexcept {
+        for ( std::size_t c = 0; c < directory_size; ++c ) {
+            if ( chunk_type * p = chunks[ c ].load ( std::memory_order_relaxed ); p ) {
+                if constexpr ( not std::is_trivially_destructible_v<value_type> ) {
+                    for ( size_type i = 0; i < chunk_size; ++i )
+                        if ( p->contains ( i ) )
+                            std::destroy_at ( p->at ( i ) );
+                }
+                std::destroy_at ( p );
+                chunk_allocator{ }.deallocate ( p, 1 );
+            }
+        }
+    }
+
+    concurrent_chunked_array & operator= ( concurrent_chunked_array const & ) = delete;
+    concurrent_chunked_array & operator= ( concurrent_chunked_array && ) = delete;
+
+    // Constructs the element in slot i_, from braced args_, and marks the slot, allocating its
+    // chunk if needed. A slot is constructed at most once.
+    template<typename... Args>
+    [[maybe_unused]] reference emplace ( size_type i_, Args &&... args_ ) {
+        assert ( ( i_ >> chunk_shift ) < directory_size );
+        chunk_type * c = chunk ( i_ );
+        assert ( not c->contains ( i_ ) );
+        pointer p = ::new ( static_cast<void *> ( c->at ( i_ ) ) ) value_type{ std::forward<Args> ( args_ )... };
+        c->constructed[ ( i_ & chunk_mask ) >> 6 ].fetch_or ( std::uint64_t{ 1 } << ( i_ & 63 ), std::memory_order_release );
+        return *p;
+    }
+
+    // Returns true if slot i_ holds a constructed element, with acquire semantics.
+    [[nodiscard]] bool contains ( size_type i_ ) const noexcept {
+        assert ( ( i_ >> chunk_shift ) < directory_size );
+        chunk_type const * c = chunks[ i_ >> chunk_shift ].load ( std::memory_order_acquire );
+        return c and c->contains ( i_ );
+    }
+
+    [[nodiscard]] reference operator[] ( size_type i_ ) noexcept {
+        return *chunks[ i_ >> chunk_shift ].load ( std::memory_order_acquire )->at ( i_ );
+    }
+    [[nodiscard]] const_reference operator[] ( size_type i_ ) const noexcept {
+        return *chunks[ i_ >> chunk_shift ].load ( std::memory_order_acquire )->at ( i_ );
+    }
+
+    private:
+    // Returns the chunk of slot i_, allocating it if needed.
+    [[nodiscard]] chunk_type * chunk ( size_type i_ ) {
+        std::atomic<chunk_type *> & c = chunks[ i_ >> chunk_shift ];
+        chunk_type * p                = c.load ( std::memory_order_acquire );
+        if ( HEDLEY_UNLIKELY ( not p ) ) {
+            chunk_type * n = ::new ( static_cast<void *> ( chunk_allocator{ }.allocate ( 1 ) ) ) chunk_type{ };
+            if ( c.compare_exchange_strong ( p, n, std::memory_order_acq_rel, std::memory_order_acquire ) ) {
+                p = n;
+            }
+            else { // Lost the race, p is the winner's chunk.
+                std::destroy_at ( n );
+                chunk_allocator{ }.deallocate ( n, 1 );
+            }
+        }
+        return p;
+    }
+
+    std::unique_ptr<std::atomic<chunk_type *>[]> chunks;
+};
+
+// A spaghetti_stack that can be pushed onto from many threads at once, as long as each
+// stack (branch) has at most one writer. A node slot is reserved with a fetch_add on the
+// shared tail index, the node is constructed in place and then published by storing the
+// new tail of the stack with release semantics. A reader that loads a tail (acquire)
+// sees the complete path from that tail down to the root, nodes are never moved. A frame
+// is reserved and constructed in the same way, and published in its own slot, notch and
+// fork don't wait on one another.
+//
+// Nodes and frames are not recycled, the arena holds at most 2^28 nodes and 2^22 frames,
+// beyond which a std::length_error is thrown. The child index of spaghetti_stack is not
+// maintained, instead pop copies the value out and leaves it in the node, where stacks
+// forked off it (possibly concurrently) share it.
+template<typename ValueType, typename SizeType>
+struct concurrent_spaghetti_stack {
+
+    using value_type      = ValueType;
+    using size_type       = SizeType;
+    using difference_type = size_type;
+
+    using pointer         = value_type *;
+    using const_pointer   = value_type const *;
+    using reference       = value_type &;
+    using const_reference = value_type const &;
+    using rv_reference    = value_type &&;
+
+    // The prev of a root node.
+    static constexpr size_type nil = static_cast<size_type> ( -1 );
+
+    private:
+    struct spaghetti_type {
+        using value_type = ValueType;
+        size_type prev   = 0;
+        value_type value = { };
+    };
+
+    struct segment_type {
+        size_type prev_tail = 0;
+        std::atomic<size_type> tail{ 0 };
+    };
+
+    using spaghetti = concurrent_chunked_array<spaghetti_type, size_type>;
+    using segment   = concurrent_chunked_array<segment_type, size_type, 10, 12>;
+
+    // The sentinel nil is never handed out as an index.
+    static constexpr std::size_t node_capacity  = std::min ( spaghetti::capacity, static_cast<std::size_t> ( nil ) );
+    static constexpr std::size_t frame_capacity = std::min ( segment::capacity, static_cast<std::size_t> ( nil ) );
+
+    public:
+    concurrent_spaghetti_stack ( )                                    = default;
+    concurrent_spaghetti_stack ( concurrent_spaghetti_stack const & ) = delete;
+
+    concurrent_spaghetti_stack & operator= ( concurrent_spaghetti_stack const & ) = delete;
+
+    // Emplace/Pop.
+
+    // Thread-safe w.r.t. pushes on other stacks, stack i_ must be owned by the caller.
+    template<typename... Args>
+    [[maybe_unused]] reference emplace ( size_type i_, Args &&... args_ ) {
+        std::atomic<size_type> & t = frame[ i_ ].tail;
+        size_type const n          = construct ( t.load ( std::memory_order_relaxed ), std::forward<Args> ( args_ )... );
+        t.store ( n, std::memory_order_release );
+        return stack[ n ].value;
+    }
+    [[maybe_unused]] reference push ( size_type i_, const_reference v_ ) { return emplace ( i_, value_type{ v_ } ); }
+
+    // Create new segment with the object created in-place at it's root. Returns a pair,
+    // a reference to the stacked value and the index of the 'new' stack, owned by the caller.
+    template<typename... Args>
+    [[maybe_unused]] sax::pair<reference, size_type> notch_emplace ( Args &&... args_ ) {
+        return new_frame ( nil, std::forward<Args> ( args_ )... );
+    }
+    [[maybe_unused]] sax::pair<reference, size_type> notch_push ( const_reference v_ ) {
+        return notch_emplace ( value_type{ v_ } );
+    }
+
+    // Create new segment, branching off the (current, acquired) tail of stack i_. Stack i_
+    // can be owned by another thread.
+    template<typename... Args>
+    [[maybe_unused]] sax::pair<reference, size_type> fork_emplace ( size_type i_, Args &&... args_ ) {
+        return new_frame ( frame[ i_ ].tail.load ( std::memory_order_acquire ), std::forward<Args> ( args_ )... );
+    }
+    [[maybe_unused]] sax::pair<reference, size_type> fork_push ( size_type i_, const_reference v_ ) {
+        return fork_emplace ( i_, value_type{ v_ } );
+    }
+
+    // Lock-free (wait-free), stack i_ must be owned by the caller. Returns a copy, the node
+    // stays in the arena and keeps its value, as a stack forked off it shares it and a fork
+    // can be taken concurrently. Readers that still hold its index can safely follow its
+    // prev, but any access to the value of a popped node, other than reading it through a
+    // stack forked off it, is unsafe.
+    [[maybe_unused]] value_type pop ( size_type i_ ) {
+        std::atomic<size_type> & t = frame[ i_ ].tail;
+        spaghetti_type const & n   = stack[ t.load ( std::memory_order_relaxed ) ];
+        assert ( t.load ( std::memory_order_relaxed ) != frame[ i_ ].prev_tail );
+        value_type v = n.value;
+        t.store ( n.prev, std::memory_order_release );
+        return v;
+    }
+
+    [[nodiscard]] bool empty ( size_type i_ ) const noexcept {
+        return frame[ i_ ].tail.load ( std::memory_order_acquire ) == frame[ i_ ].prev_tail;
+    }
+
+    [[nodiscard]] reference operator[] ( size_type i_ ) noexcept { return stack[ tail ( i_ ) ].value; }
+    [[nodiscard]] const_reference operator[] ( size_type i_ ) const noexcept { return stack[ tail ( i_ ) ].value; }
+
+    // Node access, by node index.
+    [[nodiscard]] size_type tail ( size_type i_ ) const noexcept { return frame[ i_ ].tail.load ( std::memory_order_acquire ); }
+    [[nodiscard]] size_type prev ( size_type n_ ) const noexcept { return stack[ n_ ].prev; }
+    [[nodiscard]] reference value ( size_type n_ ) noexcept { return stack[ n_ ].value; }
+    [[nodiscard]] const_reference value ( size_type n_ ) const noexcept { return stack[ n_ ].value; }
+
+    // Returns the number of reserved frames, of which the most recent ones might not be
+    // constructed yet (or never will be, if their construction threw), see validate_tail ( ).
+    [[nodiscard]] size_type size ( ) const noexcept {
+        return static_cast<size_type> ( std::min ( frame_size.load ( std::memory_order_acquire ), frame_capacity ) );
+    }
+    // Returns true if frame i_ (below size ( )) is constructed, with acquire semantics.
+    [[nodiscard]] bool validate_tail ( size_type i_ ) const noexcept { return frame.contains ( i_ ); }
+    // Returns the number of reserved node slots, of which the most recent ones might not be
+    // constructed yet, i.e. only to be iterated over in quiescence.
+    [[nodiscard]] size_type tail_index ( ) const noexcept {
+        return static_cast<size_type> ( std::min ( stack_size.load ( std::memory_order_acquire ), node_capacity ) );
+    }
+
+    private:
+    // Reserves the next index of counter_, below capacity_. A reservation past the capacity is
+    // backed off and throws, the counter is (transiently) moved past the capacity by the
+    // threads that overflow only, the indices below it are handed out once. The counters are
+    // std::size_t wide, they don't wrap, whatever the size_type.
+    [[nodiscard]] static size_type reserve ( std::atomic<std::size_t> & counter_, std::size_t capacity_, char const * what_ ) {
+        std::size_t const n = counter_.fetch_add ( 1, std::memory_order_relaxed );
+        if ( HEDLEY_UNLIKELY ( n >= capacity_ ) ) {
+            counter_.fetch_sub ( 1, std::memory_order_relaxed );
+            throw std::length_error ( what_ );
+        }
+        return static_cast<size_type> ( n );
+    }
+
+    // Reserves a slot and constructs the node in it, returns the index of the node. If the
+    // construction throws, the slot stays empty.
+    template<typename... Args>
+    [[nodiscard]] size_type construct ( size_type prev_, Args &&... args_ ) {
+        size_type const n = reserve ( stack_size, node_capacity, "concurrent_spaghetti_stack: node index overflow" );
+        stack.emplace ( n, prev_, value_type{ std::forward<Args> ( args_ )... } );
+        return n;
+    }
+
+    // The node is constructed first, then the frame, which is published in its slot, i.e. a
+    // frame never waits on the frames reserved before it.
+    template<typename... Args>
+    [[nodiscard]] sax::pair<reference, size_type> new_frame ( size_type prev_tail_, Args &&... args_ ) {
+        size_type const n = construct ( prev_tail_, std::forward<Args> ( args_ )... );
+        size_type const i = reserve ( frame_size, frame_capacity, "concurrent_spaghetti_stack: frame index overflow" );
+        frame.emplace ( i, prev_tail_, n );
+        return { stack[ n ].value, i };
+    }
+
+    spaghetti stack;
+    segment frame;
+    std::atomic<std::size_t> stack_size{ 0 }, frame_size{ 0 };
+};
@@ -0,0 +1,140 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+#include <new>
+
+#include "detail/hedley.hpp"
+#include "spaghetti_stack.hpp"
+
+// Coroutine frames (activation records) carved out of a spaghetti_stack, the frames of
+// coroutines form a tree, a coroutine spawned by another lives on a branch forked off the
+// frame of its parent. Every frame is one node, of a slot of SlotSize bytes, in a stable
+// (chunked) arena: allocating a frame is a bump of the arena, or the reuse of a dead slot,
+// and frames of related coroutines are close in memory.
+//
+// The parent of a new frame is the most recently allocated frame that is still live (on
+// the allocating thread), which is the spawning coroutine in a depth-first spawn pattern,
+// any other pattern only affects the placement. A frame that is destroyed while frames
+// forked off it are live stays in the arena, it's released with the last of them. Frames
+// larger than SlotSize come from ::operator new. A frame must be destroyed on the thread
+// that allocated it.
+template<std::size_t SlotSize = 512, typename SizeType = std::uint32_t>
+struct coroutine_frame_allocator {
+
+    using size_type = SizeType;
+
+    static constexpr std::size_t slot_size = SlotSize;
+
+    private:
+    static constexpr size_type nil = static_cast<size_type> ( -1 );
+
+    // A node of the arena, the frame of one coroutine.
+    struct slot_type {
+        slot_type ( ) noexcept {} // The frame bytes are left uninitialized.
+
+        coroutine_frame_allocator * owner = nullptr;
+        size_type node = nil, branch = nil;
+        bool live      = false;
+        alignas ( __STDCPP_DEFAULT_NEW_ALIGNMENT__ ) std::byte bytes[ slot_size ];
+    };
+
+    using stack_type = stable_spaghetti_stack<slot_type, size_type>;
+
+    public:
+    coroutine_frame_allocator ( ) noexcept                          = default;
+    coroutine_frame_allocator ( coroutine_frame_allocator const & ) = delete;
+    coroutine_frame_allocator & operator= ( coroutine_frame_allocator const & ) = delete;
+
+    // The allocator of the calling thread.
+    [[nodiscard]] static coroutine_frame_allocator & local ( ) noexcept {
+        thread_local coroutine_frame_allocator allocator;
+        return allocator;
+    }
+
+    [[nodiscard]] void * allocate ( std::size_t size_ ) {
+        if ( HEDLEY_UNLIKELY ( size_ > slot_size ) )
+            return ::operator new ( size_ );
+        size_type const b =
+            nil == top ? frames.notch_emplace ( ).second : frames.fork_emplace ( frames.value ( top ).branch ).second;
+        size_type const n = frames.tail ( b );
+        slot_type & s     = frames.value ( n );
+        s.owner           = this;
+        s.node            = n;
+        s.branch          = b;
+        s.live            = true;
+        top               = n;
+        ++live;
+        return s.bytes;
+    }
+
+    // Returns the frame p_ of size_ bytes, to the allocator that allocated it.
+    static void deallocate ( void * p_, std::size_t size_ ) noexcept {
+        if ( HEDLEY_UNLIKELY ( size_ > slot_size ) ) {
+            ::operator delete ( p_ );
+            return;
+        }
+        slot_type & s = *reinterpret_cast<slot_type *> ( static_cast<std::byte *> ( p_ ) - offsetof ( slot_type, bytes ) );
+        s.owner->release ( s );
+    }
+
+    // The number of live frames in the arena.
+    [[nodiscard]] size_type size ( ) const noexcept { return live; }
+
+    private:
+    // The frame of s_ is dead. If no frame is forked off it, it's released, and so are its
+    // dead ancestors that are left without children.
+    void release ( slot_type & s_ ) noexcept {
+        assert ( s_.live );
+        s_.live = false;
+        --live;
+        if ( top == s_.node )
+            for ( top = frames.prev ( top ); nil != top and not frames.value ( top ).live; top = frames.prev ( top ) )
+                ;
+        for ( size_type n = s_.node; nil != n and nil == frames.find_child ( n ); ) {
+            slot_type const & s = frames.value ( n );
+            if ( s.live )
+                return;
+            size_type const p = frames.prev ( n );
+            frames.remove_stack ( s.branch );
+            n = p;
+        }
+    }
+
+    stack_type frames;
+    size_type top  = nil; // The most recently allocated live frame.
+    size_type live = 0;
+};
+
+// A promise type that derives from coroutine_frame_promise has the frames of its coroutines
+// allocated by the coroutine_frame_allocator of the calling thread.
+template<typename Allocator = coroutine_frame_allocator<>>
+struct coroutine_frame_promise {
+    [[nodiscard]] static void * operator new ( std::size_t size_ ) { return Allocator::local ( ).allocate ( size_ ); }
+    static void operator delete ( void * p_, std::size_t size_ ) noexcept { Allocator::deallocate ( p_, size_ ); }
+};
@@ -0,0 +1,131 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstddef>
+
+#include <filesystem>
+#include <stdexcept>
+#include <utility>
+
+#include "hedley.hpp"
+
+#if defined( _WIN32 )
+#    ifndef NOMINMAX
+#        define NOMINMAX
+#    endif
+#    include <Windows.h>
+#else
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
+// A read-only mapping of a whole file, MapViewOfFile on Windows, mmap elsewhere. Pages are
+// read in on first touch. Failure to open or map the file throws std::runtime_error.
+
+namespace detail {
+
+struct mapped_file {
+
+    mapped_file ( ) noexcept = default;
+    explicit mapped_file ( std::filesystem::path const & path_ ) {
+#if defined( _WIN32 )
+        HANDLE file = CreateFileW ( path_.c_str ( ), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                    FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr );
+        if ( HEDLEY_UNLIKELY ( INVALID_HANDLE_VALUE == file ) )
+            throw std::runtime_error ( "mapped_file: can't open file" );
+        LARGE_INTEGER size;
+        if ( HEDLEY_UNLIKELY ( not GetFileSizeEx ( file, &size ) ) ) {
+            CloseHandle ( file );
+            throw std::runtime_error ( "mapped_file: can't size file" );
+        }
+        m_size = static_cast<std::size_t> ( size.QuadPart );
+        if ( m_size ) {
+            HANDLE mapping = CreateFileMappingW ( file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+            if ( mapping ) {
+                m_data = static_cast<std::byte const *> ( MapViewOfFile ( mapping, FILE_MAP_READ, 0, 0, 0 ) );
+                CloseHandle ( mapping );
+            }
+        }
+        CloseHandle ( file );
+        if ( HEDLEY_UNLIKELY ( m_size and not m_data ) )
+            throw std::runtime_error ( "mapped_file: can't map file" );
+#else
+        int const file = open ( path_.c_str ( ), O_RDONLY );
+        if ( HEDLEY_UNLIKELY ( -1 == file ) )
+            throw std::runtime_error ( "mapped_file: can't open file" );
+        struct stat st;
+        if ( HEDLEY_UNLIKELY ( fstat ( file, &st ) ) ) {
+            close ( file );
+            throw std::runtime_error ( "mapped_file: can't size file" );
+        }
+        m_size = static_cast<std::size_t> ( st.st_size );
+        if ( m_size ) {
+            void * p = mmap ( nullptr, m_size, PROT_READ, MAP_PRIVATE, file, 0 );
+            if ( MAP_FAILED != p )
+                m_data = static_cast<std::byte const *> ( p );
+        }
+        close ( file );
+        if ( HEDLEY_UNLIKELY ( m_size and not m_data ) )
+            throw std::runtime_error ( "mapped_file: can't map file" );
+#endif
+    }
+
+    mapped_file ( mapped_file const & ) = delete;
+    mapped_file ( mapped_file && o_ ) noexcept :
+        m_data{ std::exchange ( o_.m_data, nullptr ) }, m_size{ std::exchange ( o_.m_size, 0 ) } {}
+
+    ~mapped_file ( ) noexcept { unmap ( ); }
+
+    mapped_file & operator= ( mapped_file const & ) = delete;
+    mapped_file & operator= ( mapped_file && o_ ) noexcept {
+        if ( this != &o_ ) {
+            unmap ( );
+            m_data = std::exchange ( o_.m_data, nullptr );
+            m_size = std::exchange ( o_.m_size, 0 );
+        }
+        return *this;
+    }
+
+    [[nodiscard]] std::byte const * data ( ) const noexcept { return m_data; }
+    [[nodiscard]] std::size_t size ( ) const noexcept { return m_size; }
+
+    private:
+    void unmap ( ) noexcept {
+        if ( m_data ) {
+#if defined( _WIN32 )
+            UnmapViewOfFile ( m_data );
+#else
+            munmap ( const_cast<std::byte *> ( m_data ), m_size );
+#endif
+        }
+    }
+
+    std::byte const * m_data = nullptr;
+    std::size_t m_size       = 0;
+};
+
+} // namespace detail
@@ -0,0 +1,47 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#if defined( _MSC_VER ) && !defined( __clang__ )
+#    include <intrin.h>
+#endif
+
+// A software prefetch (into all levels of the cache) of the cache line holding p_, a hint,
+// p_ need not be dereferenceable.
+
+namespace detail {
+
+inline void prefetch ( void const * p_ ) noexcept {
+#if defined( _MSC_VER ) && !defined( __clang__ )
+#    if defined( _M_ARM64 )
+    __prefetch ( p_ );
+#    else
+    _mm_prefetch ( static_cast<char const *> ( p_ ), _MM_HINT_T0 );
+#    endif
+#else
+    __builtin_prefetch ( p_ );
+#endif
+}
+
+} // namespace detail
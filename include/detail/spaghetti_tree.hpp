@@ -0,0 +1,239 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+
+#include <iterator>
+#include <memory>
+#include <type_traits>
+
+#include "prefetch.hpp"
+
+namespace detail {
+
+// The queries over the nodes of a spaghetti_stack, shared by spaghetti_stack and by
+// spaghetti_stack_view (over an image of one), a CRTP base. Derived gives access to a node
+// through node_at ( n ), which carries the links (prev, jump, depth, child and sibling), to a
+// frame through frame_at ( i ) (prev_tail and tail) and to a value through value ( n ). With
+// SoA, the values are in an array of their own, the path_iterator prefetches those as well.
+template<typename Derived, typename ValueType, typename SizeType, typename FrameSizeType, bool SoA>
+struct spaghetti_tree {
+
+    // The prev of a root node.
+    static constexpr SizeType nil = static_cast<SizeType> ( -1 );
+    // No frame, ends the list of free frames.
+    static constexpr FrameSizeType frame_nil = static_cast<FrameSizeType> ( -1 );
+
+    // Node access, by node index.
+    [[nodiscard]] SizeType tail ( FrameSizeType i_ ) const noexcept { return derived ( ).frame_at ( i_ ).tail; }
+    [[nodiscard]] SizeType prev ( SizeType n_ ) const noexcept { return derived ( ).node_at ( n_ ).prev; }
+    // The depth of node n_, a root node is at depth 0.
+    [[nodiscard]] SizeType depth ( SizeType n_ ) const noexcept { return derived ( ).node_at ( n_ ).depth; }
+
+    // Returns the most recently stacked child of node n_, or nil if n_ is a leaf. The other
+    // children follow through next_sibling ( ).
+    [[nodiscard]] SizeType find_child ( SizeType n_ ) const noexcept { return derived ( ).node_at ( n_ ).child; }
+    [[nodiscard]] SizeType next_sibling ( SizeType n_ ) const noexcept { return derived ( ).node_at ( n_ ).sibling; }
+
+    // The number of nodes on the path of stack i_, from its tail down to its root, in O ( 1 ).
+    [[nodiscard]] SizeType stack_depth ( FrameSizeType i_ ) const noexcept {
+        return static_cast<SizeType> ( depth ( tail ( i_ ) ) + 1 );
+    }
+    // The number of nodes in the segment of stack i_, the nodes branch ( i_ ) visits, in O ( 1 ).
+    [[nodiscard]] SizeType frame_size ( FrameSizeType i_ ) const noexcept {
+        auto const & f = derived ( ).frame_at ( i_ );
+        return static_cast<SizeType> ( nil == f.prev_tail ? depth ( f.tail ) + 1 : depth ( f.tail ) - depth ( f.prev_tail ) );
+    }
+
+    // Children.
+
+    struct child_iterator {
+
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = SizeType;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = SizeType const *;
+        using reference         = SizeType;
+
+        [[nodiscard]] reference operator* ( ) const noexcept { return node; }
+        child_iterator & operator++ ( ) noexcept {
+            node = object->node_at ( node ).sibling;
+            return *this;
+        }
+        child_iterator operator++ ( int ) noexcept {
+            child_iterator tmp = *this;
+            ++*this;
+            return tmp;
+        }
+        [[nodiscard]] bool operator== ( child_iterator const & r_ ) const noexcept { return node == r_.node; }
+        [[nodiscard]] bool operator!= ( child_iterator const & r_ ) const noexcept { return node != r_.node; }
+
+        Derived const * object = nullptr;
+        SizeType node          = nil;
+    };
+
+    struct child_range {
+        [[nodiscard]] child_iterator begin ( ) const noexcept { return { object, first }; }
+        [[nodiscard]] child_iterator end ( ) const noexcept { return { object, nil }; }
+        [[nodiscard]] bool empty ( ) const noexcept { return nil == first; }
+
+        Derived const * object = nullptr;
+        SizeType first         = nil;
+    };
+
+    // The (node indices of the) children of node n_, in O ( number of children ).
+    [[nodiscard]] child_range children ( SizeType n_ ) const noexcept { return { &derived ( ), find_child ( n_ ) }; }
+
+    // Paths.
+
+    // The number of hops the path_iterator prefetches ahead.
+    static constexpr int prefetch_distance = 4;
+
+    // Walks up from a node through prev, up to (not including) node last. A second cursor runs
+    // prefetch_distance hops ahead and prefetches the node (and the value) it lands on, the
+    // node of the iterator itself was touched prefetch_distance increments earlier.
+    template<bool Const>
+    struct path_iterator {
+
+        using owner_type = std::conditional_t<Const, Derived const, Derived>;
+
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = ValueType;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = std::conditional_t<Const, value_type const, value_type> *;
+        using reference         = std::conditional_t<Const, value_type const, value_type> &;
+
+        path_iterator ( ) noexcept = default;
+        path_iterator ( owner_type * o_, SizeType n_, SizeType last_ ) noexcept :
+            object{ o_ }, at{ n_ }, ahead{ n_ }, last{ last_ } {
+            for ( int d = 0; d < prefetch_distance and ahead != last; ++d )
+                advance_ahead ( );
+        }
+
+        [[nodiscard]] reference operator* ( ) const noexcept { return object->value ( at ); }
+        [[nodiscard]] pointer operator-> ( ) const noexcept { return std::addressof ( object->value ( at ) ); }
+        // The node index of the current node.
+        [[nodiscard]] SizeType node ( ) const noexcept { return at; }
+
+        path_iterator & operator++ ( ) noexcept {
+            at = object->node_at ( at ).prev;
+            if ( ahead != last )
+                advance_ahead ( );
+            return *this;
+        }
+        path_iterator operator++ ( int ) noexcept {
+            path_iterator tmp = *this;
+            ++*this;
+            return tmp;
+        }
+        [[nodiscard]] bool operator== ( path_iterator const & r_ ) const noexcept { return at == r_.at; }
+        [[nodiscard]] bool operator!= ( path_iterator const & r_ ) const noexcept { return at != r_.at; }
+
+        private:
+        void advance_ahead ( ) noexcept {
+            ahead = object->node_at ( ahead ).prev;
+            if ( ahead != last ) {
+                detail::prefetch ( std::addressof ( object->node_at ( ahead ) ) );
+                if constexpr ( SoA )
+                    detail::prefetch ( std::addressof ( object->value ( ahead ) ) );
+            }
+        }
+
+        owner_type * object = nullptr;
+        SizeType at         = nil, ahead = nil, last = nil;
+    };
+
+    template<bool Const>
+    struct path_range {
+
+        using owner_type = typename path_iterator<Const>::owner_type;
+
+        [[nodiscard]] path_iterator<Const> begin ( ) const noexcept { return { object, first, last }; }
+        [[nodiscard]] path_iterator<Const> end ( ) const noexcept { return { object, last, last }; }
+        [[nodiscard]] bool empty ( ) const noexcept { return first == last; }
+
+        owner_type * object = nullptr;
+        SizeType first      = nil, last = nil;
+    };
+
+    // The values on the path from the tail of stack i_ down to its root, tail first, no
+    // allocation. The iterators give the node index through node ( ).
+    [[nodiscard]] path_range<true> path ( FrameSizeType i_ ) const noexcept { return { &derived ( ), tail ( i_ ), nil }; }
+    // The values of the segment of stack i_ only, from its tail down to (not including) the
+    // node it was forked off.
+    [[nodiscard]] path_range<true> branch ( FrameSizeType i_ ) const noexcept {
+        auto const & f = derived ( ).frame_at ( i_ );
+        return { &derived ( ), f.tail, f.prev_tail };
+    }
+
+    // Ancestors.
+
+    // The ancestor of node n_ at depth d_ (not deeper than n_), in O ( log depth ).
+    [[nodiscard]] SizeType ancestor_at ( SizeType n_, SizeType d_ ) const noexcept {
+        assert ( d_ <= depth ( n_ ) );
+        Derived const & self = derived ( );
+        while ( self.node_at ( n_ ).depth != d_ ) {
+            auto const & n = self.node_at ( n_ );
+            n_             = self.node_at ( n.jump ).depth < d_ ? n.prev : n.jump;
+        }
+        return n_;
+    }
+
+    // The ancestor k_ levels up from node n_ (n_ itself for k_ == 0), or nil if n_ is less deep.
+    [[nodiscard]] SizeType level_ancestor ( SizeType n_, SizeType k_ ) const noexcept {
+        return k_ > depth ( n_ ) ? nil : ancestor_at ( n_, depth ( n_ ) - k_ );
+    }
+
+    // Returns true if node a_ is an ancestor of node n_, or is n_.
+    [[nodiscard]] bool is_ancestor ( SizeType a_, SizeType n_ ) const noexcept {
+        return depth ( a_ ) <= depth ( n_ ) and ancestor_at ( n_, depth ( a_ ) ) == a_;
+    }
+
+    // The lowest common ancestor of the nodes a_ and b_, or nil if they're in different trees.
+    [[nodiscard]] SizeType lca ( SizeType a_, SizeType b_ ) const noexcept {
+        if ( depth ( a_ ) > depth ( b_ ) )
+            a_ = ancestor_at ( a_, depth ( b_ ) );
+        else
+            b_ = ancestor_at ( b_, depth ( a_ ) );
+        // At equal depth, the jumps of a_ and b_ cover equal distances.
+        Derived const & self = derived ( );
+        while ( a_ != b_ ) {
+            auto const &a = self.node_at ( a_ ), &b = self.node_at ( b_ );
+            if ( not a.depth )
+                return nil;
+            if ( a.jump != b.jump )
+                a_ = a.jump, b_ = b.jump;
+            else
+                a_ = a.prev, b_ = b.prev;
+        }
+        return a_;
+    }
+
+    private:
+    [[nodiscard]] Derived const & derived ( ) const noexcept { return static_cast<Derived const &> ( *this ); }
+};
+
+} // namespace detail
@@ -0,0 +1,106 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstddef>
+
+#include <new>
+
+#include "hedley.hpp"
+
+#if defined( _WIN32 )
+#    ifndef NOMINMAX
+#        define NOMINMAX
+#    endif
+#    include <Windows.h>
+#else
+#    include <sys/mman.h>
+#    include <unistd.h>
+#endif
+
+// Reserve address space, commit/decommit pages in it, VirtualAlloc on Windows, mmap elsewhere.
+// Failure to reserve or commit throws std::bad_alloc.
+
+namespace detail::vm {
+
+[[nodiscard]] inline std::size_t page_size ( ) noexcept {
+#if defined( _WIN32 )
+    static std::size_t const value = [] {
+        SYSTEM_INFO si;
+        GetSystemInfo ( &si );
+        return static_cast<std::size_t> ( si.dwPageSize );
+    }( );
+#else
+    static std::size_t const value = static_cast<std::size_t> ( sysconf ( _SC_PAGESIZE ) );
+#endif
+    return value;
+}
+
+[[nodiscard]] inline std::size_t round_up_to_page ( std::size_t bytes_ ) noexcept {
+    std::size_t const p = page_size ( );
+    return ( bytes_ + p - 1 ) & ~( p - 1 );
+}
+
+[[nodiscard]] inline void * reserve ( std::size_t bytes_ ) {
+#if defined( _WIN32 )
+    void * p = VirtualAlloc ( nullptr, bytes_, MEM_RESERVE, PAGE_NOACCESS );
+    if ( HEDLEY_UNLIKELY ( not p ) )
+        throw std::bad_alloc ( );
+#else
+    void * p = mmap ( nullptr, bytes_, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0 );
+    if ( HEDLEY_UNLIKELY ( MAP_FAILED == p ) )
+        throw std::bad_alloc ( );
+#endif
+    return p;
+}
+
+inline void commit ( void * p_, std::size_t bytes_ ) {
+#if defined( _WIN32 )
+    if ( HEDLEY_UNLIKELY ( not VirtualAlloc ( p_, bytes_, MEM_COMMIT, PAGE_READWRITE ) ) )
+        throw std::bad_alloc ( );
+#else
+    if ( HEDLEY_UNLIKELY ( mprotect ( p_, bytes_, PROT_READ | PROT_WRITE ) ) )
+        throw std::bad_alloc ( );
+#endif
+}
+
+// Returns the pages to the os, the address space stays reserved.
+inline void decommit ( void * p_, std::size_t bytes_ ) noexcept {
+#if defined( _WIN32 )
+    VirtualFree ( p_, bytes_, MEM_DECOMMIT );
+#else
+    madvise ( p_, bytes_, MADV_DONTNEED );
+    mprotect ( p_, bytes_, PROT_NONE );
+#endif
+}
+
+inline void release ( void * p_, [[maybe_unused]] std::size_t bytes_ ) noexcept {
+#if defined( _WIN32 )
+    VirtualFree ( p_, 0, MEM_RELEASE );
+#else
+    munmap ( p_, bytes_ );
+#endif
+}
+
+} // namespace detail::vm
@@ -0,0 +1,288 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+#include <iterator>
+#include <numeric>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+#include "detail/hedley.hpp"
+#include "spaghetti_storage.hpp"
+
+// A disjoint set (union-find) of a size that's only known at run time, next to the fixed
+// size sax::disjoint_set. Elements are added one by one, in amortized O ( 1 ), or all at once.
+// The parents, the group sizes (of the roots) and the links of the member lists are arrays
+// of SizeType (32 bits by default). Union by size and path halving give an amortized
+// O ( α ( n ) ) per operation.
+//
+// The members of a group form a circular list, a union splices the two lists in O ( 1 ), so
+// members ( ) walks a group in O ( size of the group ), and group_size ( ) is a find away.
+//
+// A group can be given a name, as with sax::disjoint_set, the name goes with the group when
+// it's united with another one, unite ( a, b ) keeps the name of the group of a if both are
+// named. The names are kept by root, of the named groups only. A name is an atom, a pointer
+// to a string that outlives the set.
+//
+// With Rollback, there is no path compression and every change, a union or a naming, goes to
+// an undo log. rollback ( ) undoes the changes made after a snapshot ( ), in O ( 1 ) per
+// change, which is what offline dynamic connectivity (a segment tree over time) needs. Union
+// by size alone keeps the trees at a height of O ( log n ), a find is O ( log n ).
+template<typename SizeType = std::uint32_t, bool Rollback = false>
+struct dynamic_disjoint_set {
+
+    using size_type = SizeType;
+    using name_type = char const *;
+
+    static_assert ( std::is_unsigned_v<size_type>, "indices must be unsigned" );
+
+    // Not an element.
+    static constexpr size_type nil = static_cast<size_type> ( -1 );
+
+    dynamic_disjoint_set ( ) = default;
+    // A set of size_ elements, every element a group of its own.
+    explicit dynamic_disjoint_set ( size_type size_ ) :
+        parent ( size_, 0 ), count ( size_, 1 ), next ( size_, 0 ), groups{ size_ } {
+        assert ( nil != size_ );
+        std::iota ( parent.begin ( ), parent.end ( ), size_type{ 0 } );
+        std::iota ( next.begin ( ), next.end ( ), size_type{ 0 } );
+    }
+
+    // Adds an element, a group of its own, returns its index.
+    [[maybe_unused]] size_type add_element ( ) {
+        size_type const x = size ( );
+        if ( HEDLEY_UNLIKELY ( nil == x ) )
+            throw std::length_error ( "dynamic_disjoint_set: index overflow" );
+        parent.push_back ( x );
+        count.push_back ( 1 );
+        next.push_back ( x );
+        ++groups;
+        return x;
+    }
+
+    void reserve ( size_type capacity_ ) {
+        parent.reserve ( capacity_ );
+        count.reserve ( capacity_ );
+        next.reserve ( capacity_ );
+    }
+
+    // Returns the root, the representative, of the group of x_. Path halving, every node on
+    // the path is linked to its grandparent, unless with Rollback.
+    [[nodiscard]] size_type find ( size_type x_ ) noexcept {
+        assert ( x_ < size ( ) );
+        while ( parent[ x_ ] != x_ ) {
+            if constexpr ( Rollback ) {
+                x_ = parent[ x_ ];
+            }
+            else {
+                size_type const p = parent[ x_ ];
+                parent[ x_ ]      = parent[ p ];
+                x_                = parent[ p ];
+            }
+        }
+        return x_;
+    }
+
+    [[nodiscard]] bool same ( size_type a_, size_type b_ ) noexcept { return find ( a_ ) == find ( b_ ); }
+
+    // Unites the groups of a_ and b_, returns the root of the united group. The root of the
+    // smaller group is linked to the other one, the member lists are spliced.
+    [[maybe_unused]] size_type unite ( size_type a_, size_type b_ ) {
+        a_ = find ( a_ ), b_ = find ( b_ );
+        if ( a_ == b_ )
+            return a_;
+        size_type const r = count[ a_ ] < count[ b_ ] ? b_ : a_, c = r == a_ ? b_ : a_; // The root, and the child.
+        if constexpr ( Rollback )
+            undo_log.push_back ( undo_type{ r, c, name ( r ), name ( c ) } );
+        parent[ c ] = r;
+        count[ r ] += count[ c ];
+        std::swap ( next[ r ], next[ c ] );
+        --groups;
+        if ( names.size ( ) )
+            pass_name ( a_, b_, r );
+        return r;
+    }
+    // Unites the groups of a_ and b_, and names the united group name_.
+    [[maybe_unused]] size_type unite ( size_type a_, size_type b_, name_type name_ ) {
+        size_type const r = unite ( a_, b_ );
+        if constexpr ( Rollback )
+            undo_log.push_back ( undo_type{ r, nil, name ( r ), nullptr } );
+        names[ r ] = name_;
+        return r;
+    }
+
+    // Unites the groups of a_ and b_, names the united group name_, returns the name.
+    [[maybe_unused]] name_type unite_name ( size_type a_, size_type b_, name_type name_ ) {
+        static_cast<void> ( unite ( a_, b_, name_ ) );
+        return name_;
+    }
+
+    // The name of the group of x_, the empty string if the group has no name.
+    [[nodiscard]] name_type find_name ( size_type x_ ) {
+        auto const n = names.find ( find ( x_ ) );
+        return names.end ( ) == n ? "" : n->second;
+    }
+
+    // The number of elements in the group of x_.
+    [[nodiscard]] size_type group_size ( size_type x_ ) noexcept { return count[ find ( x_ ) ]; }
+
+    // Members.
+
+    struct member_iterator {
+
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = size_type;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = size_type const *;
+        using reference         = size_type;
+
+        [[nodiscard]] reference operator* ( ) const noexcept { return at; }
+        member_iterator & operator++ ( ) noexcept {
+            at = ( *next )[ at ];
+            if ( at == first )
+                at = nil;
+            return *this;
+        }
+        member_iterator operator++ ( int ) noexcept {
+            member_iterator tmp = *this;
+            ++*this;
+            return tmp;
+        }
+        [[nodiscard]] bool operator== ( member_iterator const & r_ ) const noexcept { return at == r_.at; }
+        [[nodiscard]] bool operator!= ( member_iterator const & r_ ) const noexcept { return at != r_.at; }
+
+        mi_vector<size_type, size_type> const * next = nullptr;
+        size_type first = nil, at = nil;
+    };
+
+    struct member_range {
+        [[nodiscard]] member_iterator begin ( ) const noexcept { return { next, first, first }; }
+        [[nodiscard]] member_iterator end ( ) const noexcept { return { next, first, nil }; }
+
+        mi_vector<size_type, size_type> const * next = nullptr;
+        size_type first                                = nil;
+    };
+
+    // The members of the group of x_, x_ first, in O ( size of the group ). Any member of a
+    // group, not only its root, gives the whole group. Invalidated by a unite.
+    [[nodiscard]] member_range members ( size_type x_ ) const noexcept {
+        assert ( x_ < size ( ) );
+        return { &next, x_ };
+    }
+
+    // The number of elements.
+    [[nodiscard]] size_type size ( ) const noexcept { return static_cast<size_type> ( parent.size ( ) ); }
+
+    // Rollback.
+
+    // The state of the set at a snapshot, the number of elements and the size of the undo log.
+    struct snapshot_type {
+        size_type elements;
+        std::size_t log;
+    };
+
+    [[nodiscard]] snapshot_type snapshot ( ) const noexcept {
+        static_assert ( Rollback, "snapshots require the Rollback mode" );
+        return { size ( ), undo_log.size ( ) };
+    }
+
+    // Restores the state at snapshot s_, the changes are undone in reverse, the elements added
+    // after s_ are dropped. Snapshots taken after s_ are no longer valid.
+    void rollback ( snapshot_type const & s_ ) {
+        static_assert ( Rollback, "snapshots require the Rollback mode" );
+        assert ( s_.log <= undo_log.size ( ) and s_.elements <= size ( ) );
+        while ( undo_log.size ( ) > s_.log ) {
+            undo_type const & u = undo_log.back ( );
+            if ( nil != u.child ) {
+                parent[ u.child ] = u.child;
+                count[ u.root ] -= count[ u.child ];
+                std::swap ( next[ u.root ], next[ u.child ] );
+                ++groups;
+                rename ( u.child, u.child_name );
+            }
+            rename ( u.root, u.root_name );
+            undo_log.pop_back ( );
+        }
+        groups -= size ( ) - s_.elements;
+        while ( size ( ) > s_.elements ) {
+            parent.pop_back ( );
+            count.pop_back ( );
+            next.pop_back ( );
+        }
+    }
+    // The number of groups, in O ( 1 ).
+    [[nodiscard]] size_type group_count ( ) const noexcept { return groups; }
+
+    private:
+    // A union, root and child the roots that were united, child nil for a naming, and the
+    // names of both before.
+    struct undo_type {
+        size_type root, child;
+        name_type root_name, child_name;
+    };
+
+    struct none_type {};
+
+    using undo_log_type = std::conditional_t<Rollback, mi_vector<undo_type, std::size_t>, none_type>;
+
+    // The name of root r_, nullptr if it has none.
+    [[nodiscard]] name_type name ( size_type r_ ) const {
+        if ( names.empty ( ) )
+            return nullptr;
+        auto const n = names.find ( r_ );
+        return names.end ( ) == n ? nullptr : n->second;
+    }
+
+    // Sets the name of root r_, drops it for nullptr.
+    void rename ( size_type r_, name_type name_ ) {
+        if ( name_ )
+            names[ r_ ] = name_;
+        else
+            names.erase ( r_ );
+    }
+
+    // The former roots a_ and b_ are united under root r_, the name of a_ is kept, else that
+    // of b_.
+    void pass_name ( size_type a_, size_type b_, size_type r_ ) {
+        auto const a = names.find ( a_ ), b = names.find ( b_ );
+        name_type const n = names.end ( ) != a ? a->second : names.end ( ) != b ? b->second : nullptr;
+        if ( not n )
+            return;
+        names.erase ( a_ == r_ ? b_ : a_ );
+        names[ r_ ] = n;
+    }
+
+    mi_vector<size_type, size_type> parent;
+    mi_vector<size_type, size_type> count; // The size of the group, of a root.
+    mi_vector<size_type, size_type> next;  // The next member of the group, a circular list.
+    std::unordered_map<size_type, name_type> names; // By root, of the named groups.
+    size_type groups = 0;
+    undo_log_type undo_log;
+};
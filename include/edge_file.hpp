@@ -0,0 +1,185 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <exception>
+#include <filesystem>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "concurrent_disjoint_set.hpp"
+#include "detail/hedley.hpp"
+#include "detail/mapped_file.hpp"
+#include "spaghetti_storage.hpp"
+
+// The connected components of the graph in an edge file, computed in parallel. The file is
+// memory-mapped and split in as many slices as there are threads, every thread unites the
+// edges of its slice in a shared concurrent_disjoint_set, and then labels a slice of the
+// elements with their roots. The label of an element is the lowest element of its component.
+//
+// A binary edge file is an array of pairs of SizeType (native byte order). A text edge file
+// has an edge per line, the first two numbers on the line are the (decimal) indices of its
+// ends, anything in between goes, "1 <-> 3", "1 3" and "1,3" are the same edge. Blank lines,
+// lines without two numbers and lines starting with '#' are skipped. A text slice starts at
+// the first line that starts in it. Without a given number of elements, it's the highest
+// index in the file plus one, which takes an extra pass. An element out of range, or a
+// binary file of a size that isn't a multiple of an edge, throws std::runtime_error.
+
+enum class edge_file_format { binary, text };
+
+template<typename SizeType>
+struct connected_components {
+    mi_vector<SizeType, SizeType> label; // The lowest element of the component, of every element.
+    SizeType count = 0;                  // The number of components.
+};
+
+namespace detail {
+
+// Runs f_ ( t, first, last ) on threads_ threads, thread t on the slice [ first, last ) of
+// [ 0, size_ ). The first exception thrown by a thread is rethrown once all have joined.
+template<typename F>
+void for_each_slice ( std::size_t size_, unsigned threads_, F const & f_ ) {
+    std::vector<std::thread> threads;
+    std::vector<std::exception_ptr> errors ( threads_ );
+    threads.reserve ( threads_ );
+    for ( unsigned t = 0; t < threads_; ++t )
+        threads.emplace_back ( [ &, t ] {
+            try {
+                f_ ( t, size_ * t / threads_, size_ * ( t + 1 ) / threads_ );
+            }
+            catch ( ... ) {
+                errors[ t ] = std::current_exception ( );
+            }
+        } );
+    for ( std::thread & t : threads )
+        t.join ( );
+    for ( std::exception_ptr const & e : errors )
+        if ( e )
+            std::rethrow_exception ( e );
+}
+
+// Invokes f_ ( a, b ) on the edges of the lines of text that start in [ first_, last_ ), the
+// text ends at end_. The line that starts before first_ belongs to the slice before.
+template<typename SizeType, typename F>
+void for_each_text_edge ( char const * begin_, char const * first_, char const * last_, char const * end_, F && f_ ) {
+    if ( first_ != begin_ and '\n' != first_[ -1 ] ) {
+        first_ = static_cast<char const *> ( std::memchr ( first_, '\n', static_cast<std::size_t> ( end_ - first_ ) ) );
+        if ( not first_ )
+            return;
+        ++first_;
+    }
+    auto const digit  = [] ( char c_ ) noexcept { return '0' <= c_ and c_ <= '9'; };
+    auto const number = [ & ] ( char const *& p_, char const * eol_, SizeType & n_ ) {
+        while ( p_ != eol_ and not digit ( *p_ ) )
+            ++p_;
+        if ( p_ == eol_ )
+            return false;
+        std::uint64_t constexpr max = static_cast<SizeType> ( -1 ) - 1; // The highest index.
+        std::uint64_t v             = 0;
+        for ( ; p_ != eol_ and digit ( *p_ ); ++p_ ) {
+            std::uint64_t const d = static_cast<std::uint64_t> ( *p_ - '0' );
+            if ( HEDLEY_UNLIKELY ( v > ( max - d ) / 10 ) )
+                throw std::runtime_error ( "edge_file: element out of range" );
+            v = v * 10 + d;
+        }
+        n_ = static_cast<SizeType> ( v );
+        return true;
+    };
+    for ( char const * p = first_; p < last_; ) {
+        char const * eol = static_cast<char const *> ( std::memchr ( p, '\n', static_cast<std::size_t> ( end_ - p ) ) );
+        if ( not eol )
+            eol = end_;
+        SizeType a, b;
+        if ( '#' != *p and number ( p, eol, a ) and number ( p, eol, b ) )
+            f_ ( a, b );
+        p = eol + 1;
+    }
+}
+
+} // namespace detail
+
+// The connected components of the graph in the edge file path_, computed with threads_
+// threads. elements_ is the number of elements, 0 to take it from the file.
+template<typename SizeType = std::uint32_t>
+[[nodiscard]] connected_components<SizeType>
+edge_file_components ( std::filesystem::path const & path_, edge_file_format format_, SizeType elements_ = 0,
+                       unsigned threads_ = std::max ( 1u, std::thread::hardware_concurrency ( ) ) ) {
+    using size_type = SizeType;
+    assert ( threads_ );
+    detail::mapped_file const file{ path_ };
+    char const * const begin = reinterpret_cast<char const *> ( file.data ( ) );
+    char const * const end   = begin + file.size ( );
+    std::size_t const edges  = file.size ( ) / ( 2 * sizeof ( size_type ) );
+    if ( edge_file_format::binary == format_ and HEDLEY_UNLIKELY ( file.size ( ) % ( 2 * sizeof ( size_type ) ) ) )
+        throw std::runtime_error ( "edge_file: truncated binary edge file" );
+    size_type const * const pairs = reinterpret_cast<size_type const *> ( file.data ( ) );
+    // Runs f_ ( a, b ) on the edges in [ first_, last_ ), of the edges (binary) or of the bytes (text).
+    auto const for_each_edge = [ & ] ( std::size_t first_, std::size_t last_, auto && f_ ) {
+        if ( edge_file_format::binary == format_ )
+            for ( std::size_t e = first_; e < last_; ++e )
+                f_ ( pairs[ 2 * e ], pairs[ 2 * e + 1 ] );
+        else
+            detail::for_each_text_edge<size_type> ( begin, begin + first_, begin + last_, end, f_ );
+    };
+    std::size_t const slices = edge_file_format::binary == format_ ? edges : file.size ( );
+    if ( not elements_ ) {
+        std::vector<size_type> high ( threads_, 0 ); // The highest index plus one, of every slice.
+        detail::for_each_slice ( slices, threads_, [ & ] ( unsigned t_, std::size_t first_, std::size_t last_ ) {
+            size_type h = 0;
+            for_each_edge ( first_, last_, [ &h ] ( size_type a_, size_type b_ ) {
+                if ( HEDLEY_UNLIKELY ( concurrent_disjoint_set<size_type>::nil == std::max ( a_, b_ ) ) )
+                    throw std::runtime_error ( "edge_file: element out of range" );
+                h = std::max ( { h, static_cast<size_type> ( a_ + 1 ), static_cast<size_type> ( b_ + 1 ) } );
+            } );
+            high[ t_ ] = h;
+        } );
+        elements_ = *std::max_element ( high.begin ( ), high.end ( ) );
+    }
+    concurrent_disjoint_set<size_type> set ( elements_ );
+    detail::for_each_slice ( slices, threads_, [ & ] ( unsigned, std::size_t first_, std::size_t last_ ) {
+        for_each_edge ( first_, last_, [ & ] ( size_type a_, size_type b_ ) {
+            if ( HEDLEY_UNLIKELY ( a_ >= elements_ or b_ >= elements_ ) )
+                throw std::runtime_error ( "edge_file: element out of range" );
+            set.unite ( a_, b_ );
+        } );
+    } );
+    connected_components<size_type> c{ mi_vector<size_type, size_type> ( elements_, 0 ), 0 };
+    std::vector<size_type> counts ( threads_, 0 );
+    detail::for_each_slice ( elements_, threads_, [ & ] ( unsigned t_, std::size_t first_, std::size_t last_ ) {
+        size_type n = 0;
+        for ( size_type x = static_cast<size_type> ( first_ ); x < last_; ++x )
+            n += ( c.label[ x ] = set.find ( x ) ) == x;
+        counts[ t_ ] = n;
+    } );
+    for ( size_type n : counts )
+        c.count += n;
+    return c;
+}
@@ -0,0 +1,259 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include "detail/hedley.hpp"
+#include "spaghetti_storage.hpp"
+
+// A work-stealing fork-join runtime. Every worker owns a deque of forked tasks, it pushes
+// and pops at the bottom, thieves steal from the top (Chase-Lev). The frames of the tasks
+// form a cactus stack, every worker stacks the frames it forks in a region of its own (a
+// chunked_vector, frames never move), a frame links to the frame of the task that forked
+// it. A stolen task runs from its frame in place, the thief stacks the frames of the tasks
+// it forks in its own region, on top of the chain of the stolen frame, nothing is copied.
+// A worker blocks in join ( ) until its stolen task has completed, so the frames in a
+// region are released in stack order.
+//
+// The deques hold the forked children, not continuations, i.e. this is child stealing (as
+// in TBB), not the continuation stealing of Cilk: join ( ) can't capture the rest of its
+// caller as a task that can be stolen, that takes compiler support, or a stack per task.
+// The consequences: the caller of join ( ) runs f_ and then g_ if g_ wasn't stolen, so a
+// single worker executes in the serial order. A thief starts the stolen g_, not the rest of
+// the caller. A worker that waits for a stolen child doesn't suspend, it steals and runs
+// other tasks on top of its (native) stack and its region. The stack depth of a worker is
+// then not bounded by the serial depth of the computation, as with continuation stealing,
+// and a waiting worker can't resume before the task it stole on top has completed.
+//
+// Tasks must not throw. join ( ) outside of a task, or in a pool of one worker, runs both
+// tasks in the calling thread.
+struct fork_join_pool {
+
+    using size_type = std::uint32_t;
+
+    private:
+    struct task_frame {
+        task_frame * parent         = nullptr;
+        void ( *invoke ) ( void * ) = nullptr;
+        void * closure              = nullptr;
+        size_type depth             = 0;
+        std::atomic<bool> done      = false;
+    };
+
+    // The work-stealing deque of Chase and Lev (in the formulation of Lê et al.), of a fixed
+    // capacity, a push on a full deque fails.
+    struct deque_type {
+
+        static constexpr std::int64_t capacity = std::int64_t{ 1 } << 12;
+        static constexpr std::int64_t mask     = capacity - 1;
+
+        [[nodiscard]] bool push ( task_frame * t_ ) noexcept {
+            std::int64_t const b = bottom.load ( std::memory_order_relaxed );
+            if ( HEDLEY_UNLIKELY ( b - top.load ( std::memory_order_acquire ) >= capacity ) )
+                return false;
+            buffer[ b & mask ].store ( t_, std::memory_order_relaxed );
+            bottom.store ( b + 1, std::memory_order_release ); // Publishes the frame to the thieves.
+            return true;
+        }
+
+        [[nodiscard]] task_frame * pop ( ) noexcept {
+            std::int64_t const b = bottom.load ( std::memory_order_relaxed ) - 1;
+            bottom.store ( b, std::memory_order_relaxed );
+            std::atomic_thread_fence ( std::memory_order_seq_cst );
+            std::int64_t t = top.load ( std::memory_order_relaxed );
+            if ( t > b ) {
+                bottom.store ( b + 1, std::memory_order_relaxed );
+                return nullptr;
+            }
+            task_frame * x = buffer[ b & mask ].load ( std::memory_order_relaxed );
+            if ( t == b ) {
+                if ( not top.compare_exchange_strong ( t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed ) )
+                    x = nullptr;
+                bottom.store ( b + 1, std::memory_order_relaxed );
+            }
+            return x;
+        }
+
+        [[nodiscard]] task_frame * steal ( ) noexcept {
+            std::int64_t t = top.load ( std::memory_order_acquire );
+            std::atomic_thread_fence ( std::memory_order_seq_cst );
+            if ( t >= bottom.load ( std::memory_order_acquire ) )
+                return nullptr;
+            task_frame * x = buffer[ t & mask ].load ( std::memory_order_relaxed );
+            if ( not top.compare_exchange_strong ( t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed ) )
+                return nullptr;
+            return x;
+        }
+
+        alignas ( 64 ) std::atomic<std::int64_t> top{ 0 };
+        alignas ( 64 ) std::atomic<std::int64_t> bottom{ 0 };
+        std::unique_ptr<std::atomic<task_frame *>[]> buffer = std::make_unique<std::atomic<task_frame *>[]> ( capacity );
+    };
+
+    struct alignas ( 64 ) worker_type {
+        fork_join_pool * pool = nullptr;
+        deque_type deque;
+        chunked_vector<task_frame, size_type, 8> frames; // The region of the cactus stack.
+        task_frame * running = nullptr;                 // The frame of the running task.
+        std::uint64_t seed   = 0;                       // Of the choice of victim.
+    };
+
+    public:
+    explicit fork_join_pool ( unsigned workers_ = std::max ( 1u, std::thread::hardware_concurrency ( ) ) ) :
+        workers{ std::make_unique<worker_type[]> ( workers_ ) }, worker_count{ workers_ } {
+        assert ( workers_ );
+        for ( unsigned w = 0; w < workers_; ++w ) {
+            workers[ w ].pool = this;
+            workers[ w ].seed = 0x9e37'79b9'7f4a'7c15ull * ( w + 1 );
+        }
+        threads = std::make_unique<std::thread[]> ( workers_ - 1 );
+        for ( unsigned w = 1; w < workers_; ++w )
+            threads[ w - 1 ] = std::thread{ [ this, w ] { work ( workers[ w ] ); } };
+    }
+
+    fork_join_pool ( fork_join_pool const & ) = delete;
+
+    ~fork_join_pool ( ) noexcept {
+        stop.store ( true, std::memory_order_relaxed );
+        busy.store ( 1, std::memory_order_release );
+        busy.notify_all ( );
+        for ( unsigned w = 1; w < worker_count; ++w )
+            threads[ w - 1 ].join ( );
+    }
+
+    fork_join_pool & operator= ( fork_join_pool const & ) = delete;
+
+    // Runs f_ as the root task, in the calling thread (as worker 0), returns its result. The
+    // other workers steal while it runs.
+    template<typename F>
+    std::invoke_result_t<F> run ( F && f_ ) {
+        assert ( not current );
+        worker_type & w = workers[ 0 ];
+        current         = &w;
+        busy.store ( 1, std::memory_order_release );
+        busy.notify_all ( );
+        struct leave {
+            fork_join_pool & pool;
+            ~leave ( ) noexcept {
+                pool.busy.store ( 0, std::memory_order_relaxed );
+                current = nullptr;
+            }
+        } l{ *this };
+        return std::invoke ( std::forward<F> ( f_ ) );
+    }
+
+    // Forks g_, runs f_, and joins g_. A forked g_ that's not stolen runs in the calling
+    // thread, after f_, otherwise the caller steals other tasks until the thief is done.
+    template<typename F, typename G>
+    static void join ( F && f_, G && g_ ) {
+        worker_type * const w = current;
+        if ( not w or 1 == w->pool->worker_count ) {
+            std::invoke ( std::forward<F> ( f_ ) );
+            std::invoke ( std::forward<G> ( g_ ) );
+            return;
+        }
+        task_frame * const parent = w->running;
+        task_frame & t            = w->frames.emplace_back ( parent, &invoke<std::remove_reference_t<G>>,
+                                                  const_cast<void *> ( static_cast<void const *> ( std::addressof ( g_ ) ) ),
+                                                  parent ? parent->depth + 1 : 1 );
+        if ( HEDLEY_UNLIKELY ( not w->deque.push ( &t ) ) ) {
+            w->frames.pop_back ( );
+            std::invoke ( std::forward<F> ( f_ ) );
+            std::invoke ( std::forward<G> ( g_ ) );
+            return;
+        }
+        std::invoke ( std::forward<F> ( f_ ) );
+        if ( w->deque.pop ( ) == &t ) {
+            w->running = &t;
+            std::invoke ( std::forward<G> ( g_ ) );
+            w->running = parent;
+        }
+        else {
+            while ( not t.done.load ( std::memory_order_acquire ) )
+                if ( not w->pool->steal_one ( *w ) )
+                    std::this_thread::yield ( );
+        }
+        w->frames.pop_back ( );
+    }
+
+    // The fork depth of the running task, the length of its chain of frames in the cactus
+    // stack, 0 for the root task (or outside of a task).
+    [[nodiscard]] static size_type depth ( ) noexcept { return current and current->running ? current->running->depth : 0; }
+
+    [[nodiscard]] unsigned size ( ) const noexcept { return worker_count; }
+
+    private:
+    template<typename G>
+    static void invoke ( void * g_ ) {
+        std::invoke ( *static_cast<G *> ( g_ ) );
+    }
+
+    // Steals a task off a random victim and runs it on w_, returns false if there was none.
+    [[nodiscard]] bool steal_one ( worker_type & w_ ) {
+        w_.seed ^= w_.seed << 13, w_.seed ^= w_.seed >> 7, w_.seed ^= w_.seed << 17;
+        worker_type & v = workers[ w_.seed % worker_count ];
+        if ( &v == &w_ )
+            return false;
+        task_frame * const t = v.deque.steal ( );
+        if ( not t )
+            return false;
+        task_frame * const r = std::exchange ( w_.running, t );
+        t->invoke ( t->closure );
+        w_.running = r;
+        t->done.store ( true, std::memory_order_release );
+        return true;
+    }
+
+    void work ( worker_type & w_ ) {
+        current = &w_;
+        while ( not stop.load ( std::memory_order_relaxed ) ) {
+            if ( not busy.load ( std::memory_order_acquire ) ) {
+                busy.wait ( 0, std::memory_order_acquire );
+                continue;
+            }
+            if ( not steal_one ( w_ ) )
+                std::this_thread::yield ( );
+        }
+        current = nullptr;
+    }
+
+    static inline thread_local worker_type * current = nullptr;
+
+    std::unique_ptr<worker_type[]> workers;
+    std::unique_ptr<std::thread[]> threads;
+    unsigned worker_count;
+    std::atomic<int> busy{ 0 };
+    std::atomic<bool> stop{ false };
+};
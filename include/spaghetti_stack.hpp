@@ -0,0 +1,1176 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <numeric>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include <sax/stl.hpp>
+
+#include "detail/hedley.hpp"
+#include "detail/spaghetti_tree.hpp"
+#include "spaghetti_storage.hpp"
+
+// The Storage (policy) parameter determines the container of the stacked nodes. The
+// default, mi_vector, is one contiguous arena, mi_chunked_vector never moves a node once
+// it's been stacked, i.e. returned references stay valid when the arena grows. Both are
+// the spaghetti layout, (C) in the notes in main.cpp. mi_cactus_vector gives every stack
+// a region of its own, the cactus layout (B), mi_heap_vector allocates every node on its
+// own, the heap layout (A).
+//
+// With SoA, the values are not stored in the nodes, but in an array of their own, indexed
+// by node index, the nodes only hold the links. A walk up a path, or a compaction, then
+// doesn't drag the values through the cache. SoA requires a vector-like storage, its
+// iterators run over the nodes, i.e. the links, values are accessed through value ( ).
+//
+// With Dedup, the nodes are hash-consed, stacking a value that is equal to that of a child
+// of the tail (on the same parent) returns that child, instead of stacking a new node. The
+// spaghetti_stack then is a maximally shared DAG, two stacks hold equal paths if, and only
+// if, their tails are equal. Shared nodes are never released by pop or remove_stack, the
+// nodes that are no longer on the path of any stack are dropped by compact ( ). Values must
+// not be modified once stacked. Dedup requires std::hash<ValueType>, operator== and a
+// vector-like storage (which can be compacted).
+//
+// SizeType is the type of the node indices, FrameSizeType that of the stack (frame) indices,
+// it defaults to SizeType and can't be wider. With a uint32_t node index, the links of a node
+// take half the space of those with a uint64_t index, and the frames shrink further with a
+// uint16_t frame index. The all-ones index is nil (frame_nil), growing the arena, or the
+// frames, onto it throws std::length_error, widen ( ) then moves the contents to a
+// spaghetti_stack with wider indices.
+template<typename ValueType, typename SizeType, template<typename, typename> typename Storage = mi_vector, bool SoA = false,
+         bool Dedup = false, typename FrameSizeType = SizeType>
+struct spaghetti_stack
+    : detail::spaghetti_tree<spaghetti_stack<ValueType, SizeType, Storage, SoA, Dedup, FrameSizeType>, ValueType, SizeType,
+                             FrameSizeType, SoA> {
+
+    using value_type      = ValueType;
+    using size_type       = SizeType;
+    using frame_size_type = FrameSizeType;
+    using difference_type = size_type;
+
+    static_assert ( std::is_unsigned_v<size_type> and std::is_unsigned_v<frame_size_type>, "indices must be unsigned" );
+    static_assert ( sizeof ( frame_size_type ) <= sizeof ( size_type ), "a frame index can't be wider than a node index" );
+
+    private:
+    template<typename, typename, template<typename, typename> typename, bool, bool, typename>
+    friend struct spaghetti_stack;
+    friend struct spaghetti_image;
+
+    using tree_type = detail::spaghetti_tree<spaghetti_stack, ValueType, SizeType, FrameSizeType, SoA>;
+    friend tree_type;
+
+    // Next to the link to its parent (prev), a node carries a jump pointer to one of its
+    // ancestors (jump) and its depth, the head of its list of children (child) and the links
+    // to the next and previous children of its parent (sibling, prev_sibling). A node that is
+    // popped off its stack, or left by a removed stack, but stays as a branch point, is flagged
+    // (popped), it's released together with its last child.
+    struct link_type {
+        size_type prev         = 0;
+        size_type jump         = 0;
+        size_type depth        = 0;
+        size_type child        = static_cast<size_type> ( -1 );
+        size_type sibling      = static_cast<size_type> ( -1 );
+        size_type prev_sibling = static_cast<size_type> ( -1 );
+        bool popped            = false;
+    };
+
+    // The value is constructed in place, from the arguments after std::in_place.
+    struct spaghetti_type : link_type {
+        using value_type = ValueType;
+
+        spaghetti_type ( ) = default;
+        template<typename... Args>
+        spaghetti_type ( link_type const & l_, std::in_place_t, Args &&... args_ ) :
+            link_type{ l_ }, value{ std::forward<Args> ( args_ )... } {}
+
+        value_type value = { };
+    };
+
+    struct none_type {};
+
+    using node_type = std::conditional_t<SoA, link_type, spaghetti_type>;
+
+    // The tail of a free frame links to the next free frame, frame_nil (widened) ends the list.
+    struct segment_type {
+        size_type prev_tail = 0, tail = 0;
+    };
+
+    struct frame_undo_type {
+        frame_size_type index;
+        segment_type frame;
+    };
+
+    struct link_undo_type {
+        size_type index;
+        link_type link;
+    };
+
+    using spaghetti  = Storage<node_type, size_type>;
+    using values     = std::conditional_t<SoA, Storage<ValueType, size_type>, none_type>;
+    using node_table = std::conditional_t<Dedup, index_hash_set<size_type>, none_type>;
+    using segment    = mi_vector<segment_type, frame_size_type>;
+
+    static_assert ( not SoA or not is_segmented_storage_v<spaghetti>, "SoA requires a vector-like storage" );
+    static_assert ( not Dedup or not is_segmented_storage_v<spaghetti>, "Dedup requires a vector-like storage" );
+
+    public:
+    using iterator               = typename spaghetti::iterator;
+    using const_iterator         = typename spaghetti::const_iterator;
+    using reverse_iterator       = typename spaghetti::reverse_iterator;
+    using const_reverse_iterator = typename spaghetti::const_reverse_iterator;
+
+    using pointer         = value_type *;
+    using const_pointer   = value_type const *;
+    using reference       = value_type &;
+    using const_reference = value_type const &;
+    using rv_reference    = value_type &&;
+
+    using tree_type::frame_nil;
+    using tree_type::nil;
+
+    // Emplace/Pop.
+
+    public:
+    template<typename... Args>
+    [[maybe_unused]] reference emplace ( frame_size_type i_, Args &&... args_ ) {
+        assert ( validate_tail ( i_ ) );
+        log_frame ( i_ );
+        size_type & t = frame[ i_ ].tail;
+        t             = stack_node ( t, false, std::forward<Args> ( args_ )... );
+        return value ( t );
+    }
+    [[maybe_unused]] reference push ( frame_size_type i_, const_reference v_ ) { return emplace ( i_, v_ ); }
+    [[maybe_unused]] reference push ( frame_size_type i_, rv_reference v_ ) { return emplace ( i_, std::move ( v_ ) ); }
+
+    // Create new segment with the object created in-place at it's root. Returns a pair,
+    // a reference to the stacked value and the index of the 'new' stack.
+    template<typename... Args>
+    [[maybe_unused]] sax::pair<reference, frame_size_type> notch_emplace ( Args &&... args_ ) {
+        size_type const n = stack_node ( nil, true, std::forward<Args> ( args_ )... );
+        return { value ( n ), new_frame ( segment_type{ nil, n } ) };
+    }
+    [[maybe_unused]] sax::pair<reference, frame_size_type> notch_push ( const_reference v_ ) { return notch_emplace ( v_ ); }
+    [[maybe_unused]] sax::pair<reference, frame_size_type> notch_push ( rv_reference v_ ) {
+        return notch_emplace ( std::move ( v_ ) );
+    }
+
+    // Create new segment, branching off the tail of stack i_, with the object created in-place
+    // at it's root. The tail of stack i_ becomes a branch point. Returns a pair, a reference to
+    // the stacked value and the index of the 'new' stack.
+    template<typename... Args>
+    [[maybe_unused]] sax::pair<reference, frame_size_type> fork_emplace ( frame_size_type i_, Args &&... args_ ) {
+        assert ( validate_tail ( i_ ) );
+        size_type const p = frame[ i_ ].tail;
+        size_type const n = stack_node ( p, true, std::forward<Args> ( args_ )... );
+        return { value ( n ), new_frame ( segment_type{ p, n } ) };
+    }
+    [[maybe_unused]] sax::pair<reference, frame_size_type> fork_push ( frame_size_type i_, const_reference v_ ) {
+        return fork_emplace ( i_, v_ );
+    }
+    [[maybe_unused]] sax::pair<reference, frame_size_type> fork_push ( frame_size_type i_, rv_reference v_ ) {
+        return fork_emplace ( i_, std::move ( v_ ) );
+    }
+
+    // The nodes of a removed stack are dropped from the child index, up to the first node
+    // that is shared, and released to the storage, as are the popped branch points of which
+    // they were the last children. The shared nodes of the segment that stay are flagged as
+    // popped. In the spaghetti layout the slots are reused by new nodes, unless on top of the
+    // arena, which shrinks. The frame is recycled.
+    void remove_stack ( frame_size_type i_ ) {
+        assert ( validate_tail ( i_ ) );
+        if constexpr ( not Dedup ) {
+            segment_type const & f = frame[ i_ ];
+            size_type n            = f.tail;
+            while ( n != f.prev_tail and nil == stack[ n ].child ) {
+                size_type const p = stack[ n ].prev;
+                unlink ( n );
+                release ( n );
+                n = p;
+            }
+            if ( n == f.prev_tail ) {
+                release_popped ( n );
+            }
+            else {
+                for ( ; n != f.prev_tail; n = stack[ n ].prev ) {
+                    log_link ( n );
+                    stack[ n ].popped = true;
+                }
+            }
+        }
+        free_frame ( i_ );
+    }
+
+    // Children and paths, the queries are those of the spaghetti_tree (shared with the
+    // spaghetti_stack_view), the paths over values that can be modified are added here.
+
+    using tree_type::children;
+    using tree_type::find_child;
+    using tree_type::next_sibling;
+
+    template<bool Const>
+    using path_iterator = typename tree_type::template path_iterator<Const>;
+    template<bool Const>
+    using path_range = typename tree_type::template path_range<Const>;
+
+    using tree_type::branch;
+    using tree_type::path;
+
+    [[nodiscard]] path_range<false> path ( frame_size_type i_ ) noexcept { return { this, frame[ i_ ].tail, nil }; }
+    [[nodiscard]] path_range<false> branch ( frame_size_type i_ ) noexcept {
+        return { this, frame[ i_ ].tail, frame[ i_ ].prev_tail };
+    }
+
+    // Pops the tail of stack i_ and returns its value, moved out of the node if the node is
+    // released, copied if it stays, as a branch point (or shared, with Dedup), or below the mark
+    // of an active checkpoint, a rollback restores it. A move-only value can only be popped off
+    // a node that is released, visit_pop ( ) has no such restriction.
+    [[maybe_unused]] value_type pop ( frame_size_type i_ ) {
+        assert ( tail_index ( ) );
+        assert ( validate_tail ( i_ ) );
+        size_type const t = frame[ i_ ].tail;
+        value_type v      = [ this, t ] ( ) -> value_type {
+            if constexpr ( std::is_copy_constructible_v<value_type> ) {
+                if ( stays ( t ) )
+                    return value ( t );
+            }
+            else {
+                assert ( not stays ( t ) );
+            }
+            return std::move ( value ( t ) );
+        }( );
+        pop_tail ( i_ );
+        return v;
+    }
+
+    [[maybe_unused]] value_type pop ( ) { return pop ( 0 ); }
+
+    // Invokes f_ on the value at the tail of stack i_, in place, and pops it, returns what f_
+    // returns. f_ may move from the value, unless the node stays, as a branch point (or shared,
+    // with Dedup), or below the mark of an active checkpoint. If f_ throws, nothing is popped.
+    template<typename F>
+    decltype ( auto ) visit_pop ( frame_size_type i_, F && f_ ) {
+        assert ( tail_index ( ) );
+        assert ( validate_tail ( i_ ) );
+        using result_type = std::invoke_result_t<F, reference>;
+        if constexpr ( std::is_void_v<result_type> ) {
+            std::invoke ( std::forward<F> ( f_ ), value ( frame[ i_ ].tail ) );
+            pop_tail ( i_ );
+        }
+        else {
+            result_type r = std::invoke ( std::forward<F> ( f_ ), value ( frame[ i_ ].tail ) );
+            pop_tail ( i_ );
+            return r;
+        }
+    }
+
+    // The value at the tail of stack i_.
+    [[nodiscard]] reference top ( frame_size_type i_ ) noexcept { return value ( frame[ i_ ].tail ); }
+    [[nodiscard]] const_reference top ( frame_size_type i_ ) const noexcept { return value ( frame[ i_ ].tail ); }
+
+    [[nodiscard]] reference operator[] ( frame_size_type i_ ) noexcept { return value ( frame[ i_ ].tail ); }
+    [[nodiscard]] const_reference operator[] ( frame_size_type i_ ) const noexcept { return value ( frame[ i_ ].tail ); }
+
+    // Ancestors, and node access by node index.
+
+    using tree_type::ancestor_at;
+    using tree_type::depth;
+    using tree_type::is_ancestor;
+    using tree_type::lca;
+    using tree_type::level_ancestor;
+    using tree_type::prev;
+    using tree_type::tail;
+
+    [[nodiscard]] reference value ( size_type n_ ) noexcept {
+        if constexpr ( SoA )
+            return value_stack[ n_ ];
+        else
+            return stack[ n_ ].value;
+    }
+    [[nodiscard]] const_reference value ( size_type n_ ) const noexcept {
+        if constexpr ( SoA )
+            return value_stack[ n_ ];
+        else
+            return stack[ n_ ].value;
+    }
+
+    // Returns the number of spaghetti-stacks.
+    [[nodiscard]] frame_size_type size ( ) const noexcept { return frame.size ( ); }
+    // Returns the number of nodes in the arena (the number of live nodes with a segmented storage).
+    [[nodiscard]] size_type tail_index ( ) const noexcept { return static_cast<size_type> ( stack.size ( ) ); }
+    // Returns the number of live nodes, the nodes in the arena less the dead slots, in O ( 1 ).
+    [[nodiscard]] size_type node_count ( ) const noexcept { return live; }
+
+    using tree_type::frame_size;
+    using tree_type::stack_depth;
+
+    [[nodiscard]] bool validate_tail ( frame_size_type i_ ) const noexcept { return 0 <= i_ and i_ < frame.size ( ); }
+
+    [[nodiscard]] iterator begin ( ) noexcept { return stack.begin ( ); }
+    [[nodiscard]] const_iterator begin ( ) const noexcept { return stack.begin ( ); }
+    [[nodiscard]] iterator end ( ) noexcept { return stack.end ( ); }
+    [[nodiscard]] const_iterator end ( ) const noexcept { return stack.end ( ); }
+
+    // Compaction.
+
+    using index_map = mi_vector<size_type, size_type>;
+
+    // An incremental compaction of the arena (of a vector-like storage). The dead nodes are
+    // dropped and the live nodes, the nodes on the path of a stack, are moved into depth-first
+    // order in a new arena. A step ( budget_ ) visits at most budget_ nodes and returns true
+    // once the compaction is complete. In between steps the spaghetti_stack can be read, but
+    // must not be modified. The last step swaps in the new arena and rewrites the frames,
+    // remap ( ) then maps old node indices to new ones (nil for dropped nodes).
+    struct compaction {
+
+        explicit compaction ( spaghetti_stack & s_ ) :
+            object{ s_ }, frames{ s_.size ( ) }, nodes{ s_.tail_index ( ) }, map ( s_.tail_index ( ), nil ),
+            marks ( ( s_.tail_index ( ) + 63 ) / 64, 0 ), unused ( ( s_.size ( ) + 63 ) / 64, 0 ) {
+            static_assert ( not is_segmented_storage_v<spaghetti>, "compaction requires a vector-like storage" );
+            assert ( object.checkpoints.empty ( ) );
+            for ( frame_size_type f = object.free; frame_nil != f; f = static_cast<frame_size_type> ( object.frame[ f ].tail ) )
+                unused[ f >> 6 ] |= std::uint64_t{ 1 } << ( f & 63 );
+        }
+
+        [[maybe_unused]] bool step ( size_type budget_ ) {
+            assert ( frames == object.size ( ) and nodes == object.tail_index ( ) );
+            switch ( state ) {
+                case phase::mark: mark ( budget_ ); break;
+                case phase::order: order ( budget_ ); break;
+                case phase::move: move ( budget_ ); break;
+                case phase::done: break;
+            }
+            return phase::done == state;
+        }
+
+        [[nodiscard]] bool done ( ) const noexcept { return phase::done == state; }
+        [[nodiscard]] index_map const & remap ( ) const noexcept { return map; }
+        [[nodiscard]] index_map & remap ( ) noexcept { return map; }
+
+        private:
+        enum class phase { mark, order, move, done };
+
+        using bit_map = mi_vector<std::uint64_t, size_type>;
+
+        [[nodiscard]] static bool test ( bit_map const & bits_, size_type i_ ) noexcept {
+            return bits_[ i_ >> 6 ] >> ( i_ & 63 ) & 1;
+        }
+
+        // Walk from the tail of every live frame down to the root, or to a marked node.
+        void mark ( size_type budget_ ) {
+            while ( budget_ ) {
+                if ( nil == cursor ) {
+                    if ( frame_cursor == frames ) {
+                        for ( size_type r = static_cast<size_type> ( roots.size ( ) ); r--; )
+                            todo.push_back ( roots[ r ] );
+                        state = phase::order;
+                        return;
+                    }
+                    if ( frame_size_type const f = frame_cursor++; not test ( unused, f ) )
+                        cursor = object.frame[ f ].tail;
+                    continue;
+                }
+                if ( test ( marks, cursor ) ) {
+                    cursor = nil;
+                    continue;
+                }
+                marks[ cursor >> 6 ] |= std::uint64_t{ 1 } << ( cursor & 63 );
+                if ( size_type const p = object.stack[ cursor ].prev; nil != p )
+                    cursor = p;
+                else
+                    roots.push_back ( std::exchange ( cursor, nil ) );
+                --budget_;
+            }
+        }
+
+        // Number the marked nodes in depth-first pre-order, the oldest child first.
+        void order ( size_type budget_ ) {
+            for ( ; budget_ and todo.size ( ); --budget_ ) {
+                size_type const n = todo.back ( );
+                todo.pop_back ( );
+                map[ n ] = static_cast<size_type> ( sequence.size ( ) );
+                sequence.push_back ( n );
+                for ( size_type c : object.children ( n ) )
+                    if ( test ( marks, c ) )
+                        todo.push_back ( c );
+            }
+            if ( todo.empty ( ) ) {
+                arena.reserve ( static_cast<size_type> ( sequence.size ( ) ) );
+                if constexpr ( SoA )
+                    value_arena.reserve ( static_cast<size_type> ( sequence.size ( ) ) );
+                cursor = 0;
+                state  = phase::move;
+            }
+        }
+
+        // Copy the nodes into the new arena, parents are copied before their children.
+        void move ( size_type budget_ ) {
+            for ( ; budget_ and cursor < sequence.size ( ); --budget_ ) {
+                size_type const n = sequence[ cursor++ ];
+                link_type const l{ .prev   = nil == object.stack[ n ].prev ? nil : map[ object.stack[ n ].prev ],
+                                   .popped = object.stack[ n ].popped };
+                if constexpr ( SoA ) {
+                    arena.emplace_back ( l );
+                    value_arena.emplace_back ( copy_or_move ( object.value ( n ) ) );
+                }
+                else {
+                    arena.emplace_back ( l, std::in_place, copy_or_move ( object.value ( n ) ) );
+                }
+                size_type const a = static_cast<size_type> ( arena.size ( ) - 1 );
+                link ( arena, a );
+                if constexpr ( Dedup )
+                    table.insert ( hash_node ( l.prev, object.value ( n ) ), a );
+            }
+            if ( cursor == sequence.size ( ) ) {
+                for ( frame_size_type f = 0; f < frames; ++f ) {
+                    segment_type & s = object.frame[ f ];
+                    if ( test ( unused, f ) )
+                        s.prev_tail = nil;
+                    else
+                        s = segment_type{ nil == s.prev_tail ? nil : map[ s.prev_tail ], map[ s.tail ] };
+                }
+                std::swap ( object.stack, arena );
+                object.dead = nil;
+                object.live = static_cast<size_type> ( sequence.size ( ) );
+                arena = spaghetti{ };
+                if constexpr ( SoA ) {
+                    std::swap ( object.value_stack, value_arena );
+                    value_arena = values{ };
+                }
+                if constexpr ( Dedup )
+                    std::swap ( object.table, table );
+                state = phase::done;
+            }
+        }
+
+        // Values that can be copied are, the old arena stays readable until the last step.
+        [[nodiscard]] static decltype ( auto ) copy_or_move ( value_type & v_ ) noexcept {
+            if constexpr ( std::is_copy_constructible_v<value_type> )
+                return static_cast<const_reference> ( v_ );
+            else
+                return std::move ( v_ );
+        }
+
+        spaghetti_stack & object;
+        frame_size_type frames;
+        size_type nodes;
+        index_map map;
+        bit_map marks, unused;
+        index_map roots, todo, sequence;
+        spaghetti arena;
+        values value_arena;
+        node_table table;
+        frame_size_type frame_cursor = 0;
+        size_type cursor             = nil;
+        phase state                  = phase::mark;
+    };
+
+    // Returns a compaction, to be stepped by the caller.
+    [[nodiscard]] compaction compactor ( ) { return compaction{ *this }; }
+
+    // Compacts the arena in one go, returns the map of old to new node indices.
+    [[maybe_unused]] index_map compact ( ) {
+        compaction c{ *this };
+        while ( not c.step ( nil ) )
+            ;
+        return std::move ( c.remap ( ) );
+    }
+
+    // Checkpoints.
+
+    // The state of the spaghetti_stack at a checkpoint, the sizes of the arena and the frames,
+    // the heads of the free lists of frames and of (dead) nodes, the number of live nodes and
+    // the sizes of the undo logs and of the list of deferred releases.
+    struct checkpoint_type {
+        size_type level, nodes;
+        frame_size_type frames, free;
+        size_type dead, live, frame_log, link_log, deferred;
+    };
+
+    // Starts a (nested) transaction. Until it's rolled back or committed, nodes below the mark
+    // are not released, but listed, and the frames and node slots that were free at the mark
+    // are not reused, the arena and the frames only grow past the mark. The changes to the
+    // links of nodes and to frames below the mark go to an undo log. Values are not logged.
+    // Requires a vector-like storage, no compaction while a checkpoint is active.
+    [[nodiscard]] checkpoint_type checkpoint ( ) {
+        static_assert ( not is_segmented_storage_v<spaghetti>, "checkpoints require a vector-like storage" );
+        checkpoints.push_back ( checkpoint_type{ static_cast<size_type> ( checkpoints.size ( ) ), tail_index ( ), size ( ), free,
+                                                 dead, live, static_cast<size_type> ( frame_log.size ( ) ),
+                                                 static_cast<size_type> ( link_log.size ( ) ),
+                                                 static_cast<size_type> ( deferred.size ( ) ) } );
+        return checkpoints.back ( );
+    }
+
+    // Restores the state at checkpoint c_, and drops c_ and all checkpoints taken after it.
+    // The undo logs are replayed in reverse, the arena and the frames are truncated back to the
+    // mark, the free lists restored and the releases deferred since dropped. The cost is that
+    // of replaying the undo logs, the truncation is O ( 1 ) for trivially destructible nodes.
+    void rollback ( checkpoint_type const & c_ ) noexcept {
+        assert ( c_.level < checkpoints.size ( ) );
+        for ( size_type l = static_cast<size_type> ( link_log.size ( ) ); l-- > c_.link_log; )
+            static_cast<link_type &> ( stack[ link_log[ l ].index ] ) = link_log[ l ].link;
+        for ( size_type l = static_cast<size_type> ( frame_log.size ( ) ); l-- > c_.frame_log; )
+            frame[ frame_log[ l ].index ] = frame_log[ l ].frame;
+        if constexpr ( Dedup )
+            for ( size_type n = tail_index ( ); n-- > c_.nodes; )
+                table.erase ( hash_node ( stack[ n ].prev, value ( n ) ), n );
+        truncate ( stack, c_.nodes );
+        if constexpr ( SoA )
+            truncate ( value_stack, c_.nodes );
+        truncate ( frame, c_.frames );
+        free = c_.free;
+        dead = c_.dead;
+        live = c_.live;
+        truncate ( link_log, c_.link_log );
+        truncate ( frame_log, c_.frame_log );
+        truncate ( deferred, c_.deferred );
+        truncate ( checkpoints, c_.level );
+    }
+
+    // Keeps the changes made after checkpoint c_, and drops c_ and all checkpoints taken after
+    // it. The undo logs are kept for the checkpoints taken before c_. The releases deferred
+    // since c_ are applied, but for those of nodes below the mark of the checkpoint before c_.
+    void commit ( checkpoint_type const & c_ ) noexcept {
+        assert ( c_.level < checkpoints.size ( ) );
+        truncate ( checkpoints, c_.level );
+        if ( checkpoints.empty ( ) ) {
+            link_log.clear ( );
+            frame_log.clear ( );
+        }
+        size_type d = c_.deferred;
+        for ( size_type l = c_.deferred; l < deferred.size ( ); ++l ) {
+            if ( checkpoints.empty ( ) or deferred[ l ] >= checkpoints.back ( ).nodes )
+                reclaim ( deferred[ l ] );
+            else
+                deferred[ d++ ] = deferred[ l ];
+        }
+        truncate ( deferred, d );
+    }
+
+    // Bulk loading.
+
+    // Replaces the contents by the forest given as a parent array, parents_[ n ] is the index
+    // of the parent of node n, or nil for a root, a parent precedes its children. Node n holds
+    // values_[ n ]. The first child of a node continues the stack of its parent, the other
+    // children are forked off it, every leaf is the tail of a stack. Frames are numbered in the
+    // order of the first node of their segment. The arena is reserved once and filled in one
+    // linear pass, without the checks of emplace.
+    template<typename ParentRange, typename ValueRange>
+    void bulk_load ( ParentRange const & parents_, ValueRange const & values_ ) {
+        size_type const count = start_bulk_load ( std::size ( parents_ ), std::size ( values_ ) );
+        mi_vector<frame_size_type, size_type> owner ( count, frame_nil ); // The frame of the segment a node belongs to.
+        auto p = std::begin ( parents_ );
+        auto v = std::begin ( values_ );
+        for ( size_type n = 0; n < count; ++n, ++p, ++v ) {
+            assert ( nil == *p or *p < n );
+            size_type const prev = static_cast<size_type> ( *p );
+            static_cast<void> ( stack_emplace ( prev, false, *v ) );
+            if ( nil == prev or nil != stack[ prev ].child ) {
+                owner[ n ] = push_frame ( segment_type{ prev, n } );
+            }
+            else {
+                owner[ n ]                  = owner[ prev ];
+                frame[ owner[ prev ] ].tail = n;
+            }
+            link ( stack, n );
+        }
+    }
+
+    // Replaces the contents by the forest given in depth-first pre-order, as the depth of every
+    // node (a root has depth 0), node n holds values_[ n ]. The stacks are those of the parent
+    // array form. In pre-order, a segment is a run of nodes each one deeper than the one before
+    // it, the frames follow from an inclusive scan over the flags marking the start of a run.
+    template<typename DepthRange, typename ValueRange>
+    void bulk_load_preorder ( DepthRange const & depths_, ValueRange const & values_ ) {
+        if ( size_type const count = load_preorder ( depths_, values_ ); count )
+            preorder_frames ( depths_, count );
+    }
+
+    // As above, the flags, the scan and the filling of the frames run under the execution policy
+    // policy_ (e.g. std::execution::par, of <execution>, which the caller includes), the nodes
+    // are stacked and linked in one linear pass.
+    template<typename ExecutionPolicy, typename DepthRange, typename ValueRange>
+    void bulk_load_preorder ( ExecutionPolicy && policy_, DepthRange const & depths_, ValueRange const & values_ ) {
+        if ( size_type const count = load_preorder ( depths_, values_ ); count )
+            preorder_frames ( depths_, count, std::forward<ExecutionPolicy> ( policy_ ) );
+    }
+
+    // Widening.
+
+    // Moves the contents to a spaghetti_stack with wider node and frame indices, the way out of
+    // a std::length_error. Node and frame indices are kept, nil and frame_nil are mapped to
+    // those of the wider type. Leaves *this empty. Requires a vector-like storage, no
+    // checkpoint active.
+    template<typename WideSizeType, typename WideFrameSizeType = WideSizeType>
+    [[nodiscard]] spaghetti_stack<ValueType, WideSizeType, Storage, SoA, Dedup, WideFrameSizeType> widen ( ) && {
+        using wide_type = spaghetti_stack<ValueType, WideSizeType, Storage, SoA, Dedup, WideFrameSizeType>;
+        static_assert ( not is_segmented_storage_v<spaghetti>, "widening requires a vector-like storage" );
+        static_assert ( sizeof ( WideSizeType ) >= sizeof ( size_type ) and
+                        sizeof ( WideFrameSizeType ) >= sizeof ( frame_size_type ) );
+        assert ( checkpoints.empty ( ) );
+        auto const wide = [] ( size_type n_ ) noexcept {
+            return nil == n_ ? wide_type::nil : static_cast<WideSizeType> ( n_ );
+        };
+        auto const wide_frame = [] ( frame_size_type f_ ) noexcept {
+            return frame_nil == f_ ? wide_type::frame_nil : static_cast<WideFrameSizeType> ( f_ );
+        };
+        wide_type w;
+        w.stack.reserve ( tail_index ( ) );
+        if constexpr ( SoA )
+            w.value_stack.reserve ( tail_index ( ) );
+        for ( size_type n = 0; n < tail_index ( ); ++n ) {
+            node_type const & o = stack[ n ];
+            typename wide_type::link_type const l{ wide ( o.prev ),  wide ( o.jump ),    wide ( o.depth ),
+                                                   wide ( o.child ), wide ( o.sibling ), wide ( o.prev_sibling ),
+                                                   o.popped };
+            if constexpr ( SoA ) {
+                w.stack.emplace_back ( l );
+                w.value_stack.emplace_back ( std::move ( value_stack[ n ] ) );
+            }
+            else {
+                w.stack.emplace_back ( l, std::in_place, std::move ( value ( n ) ) );
+            }
+            if constexpr ( Dedup )
+                w.table.insert ( wide_type::hash_node ( l.prev, w.value ( n ) ), n );
+        }
+        w.frame.reserve ( size ( ) );
+        for ( segment_type const & f : frame )
+            w.frame.push_back ( { wide ( f.prev_tail ), wide ( f.tail ) } );
+        for ( frame_size_type f = free; frame_nil != f; f = static_cast<frame_size_type> ( frame[ f ].tail ) )
+            w.frame[ f ].tail = wide_frame ( static_cast<frame_size_type> ( frame[ f ].tail ) );
+        w.free = wide_frame ( free );
+        w.dead = wide ( dead );
+        w.live = live;
+        *this  = spaghetti_stack{ };
+        return w;
+    }
+
+    // Merging.
+
+    // Moves the nodes and the frames of other_ into this spaghetti_stack, in one pass over the
+    // arena of other_: its nodes are appended to the arena and its frames to the frames, their
+    // indices relocated by the sizes of the arena and the frames of *this. attach_ ( r_ ) gives
+    // the node of *this that the tree of other_ rooted at r_ (a node index of other_) hangs off,
+    // or nil to keep it a tree of its own. An attached tree is linked in as if its nodes had
+    // been stacked on that node (only its depths and jumps are walked again), the stacks
+    // notched at r_ become forks off it. Returns the
+    // offsets of the node and the frame indices of other_, leaves other_ empty. Requires a
+    // vector-like storage, no Dedup, no checkpoint active.
+    template<typename Attach>
+    [[maybe_unused]] sax::pair<size_type, frame_size_type> merge ( spaghetti_stack && other_, Attach && attach_ ) {
+        static_assert ( not is_segmented_storage_v<spaghetti>, "merging requires a vector-like storage" );
+        static_assert ( not Dedup, "a hash-consed spaghetti_stack can't be merged" );
+        assert ( this != &other_ );
+        assert ( checkpoints.empty ( ) and other_.checkpoints.empty ( ) );
+        size_type const nodes = tail_index ( ), count = other_.tail_index ( );
+        frame_size_type const frames = size ( ), frame_count = other_.size ( );
+        if ( HEDLEY_UNLIKELY ( count > nil - nodes ) )
+            throw std::length_error ( "spaghetti_stack: node index overflow" );
+        if ( HEDLEY_UNLIKELY ( frame_count > frame_nil - frames ) )
+            throw std::length_error ( "spaghetti_stack: frame index overflow" );
+        auto const shift = [ nodes ] ( size_type n_ ) noexcept {
+            return nil == n_ ? nil : static_cast<size_type> ( n_ + nodes );
+        };
+        // The dead slots of other_ are copied, but are not roots.
+        mi_vector<std::uint64_t, size_type> dead_slots ( count / 64 + 1, 0 );
+        for ( size_type n = other_.dead; nil != n; n = other_.stack[ n ].prev )
+            dead_slots[ n >> 6 ] |= std::uint64_t{ 1 } << ( n & 63 );
+        index_map roots; // The roots of other_, relocated.
+        stack.reserve ( nodes + count );
+        if constexpr ( SoA )
+            value_stack.reserve ( nodes + count );
+        for ( size_type n = 0; n < count; ++n ) {
+            node_type & o = other_.stack[ n ];
+            link_type const l{ shift ( o.prev ),  shift ( o.jump ),    o.depth,
+                               shift ( o.child ), shift ( o.sibling ), shift ( o.prev_sibling ),
+                               o.popped };
+            if constexpr ( SoA ) {
+                stack.emplace_back ( l );
+                value_stack.emplace_back ( std::move ( other_.value_stack[ n ] ) );
+            }
+            else {
+                stack.emplace_back ( l, std::in_place, std::move ( o.value ) );
+            }
+            if ( nil == o.prev and not( dead_slots[ n >> 6 ] >> ( n & 63 ) & 1 ) )
+                roots.push_back ( shift ( n ) );
+        }
+        // The frames, the free frames of other_ go in front of those of *this. The stacks notched
+        // in other_ are marked, with their roots, for the attachments.
+        index_map notched ( frame_count, nil );
+        frame.reserve ( frames + frame_count );
+        for ( segment_type const & f : other_.frame )
+            frame.push_back ( { shift ( f.prev_tail ), shift ( f.tail ) } );
+        for ( frame_size_type f = other_.free; frame_nil != f; ) {
+            frame_size_type const next = static_cast<frame_size_type> ( other_.frame[ f ].tail );
+            frame_size_type const link = frame_nil == next ? free : static_cast<frame_size_type> ( frames + next );
+            frame[ frames + f ]        = { 0, static_cast<size_type> ( link ) };
+            f                          = next;
+        }
+        if ( frame_nil != other_.free )
+            free = static_cast<frame_size_type> ( frames + other_.free );
+        for ( frame_size_type f = 0; f < frame_count; ++f )
+            if ( segment_type const & s = frame[ frames + f ]; nil == s.prev_tail )
+                notched[ f ] = ancestor_at ( s.tail, 0 );
+        // The attachments, an attached tree gets the depths and jumps of its new position.
+        for ( size_type const r : roots ) {
+            size_type const a = attach_ ( static_cast<size_type> ( r - nodes ) );
+            if ( nil == a )
+                continue;
+            assert ( a < nodes );
+            stack[ r ].prev = a;
+            link ( stack, r );
+            index_map todo ( 1, r );
+            while ( todo.size ( ) ) {
+                size_type const n = todo.back ( );
+                todo.pop_back ( );
+                for ( size_type const c : children ( n ) ) {
+                    set_jump ( stack, c );
+                    todo.push_back ( c );
+                }
+            }
+        }
+        for ( frame_size_type f = 0; f < frame_count; ++f )
+            if ( nil != notched[ f ] )
+                frame[ frames + f ].prev_tail = stack[ notched[ f ] ].prev;
+        if ( nil != other_.dead ) {
+            size_type d = shift ( other_.dead );
+            while ( nil != stack[ d ].prev )
+                d = stack[ d ].prev;
+            stack[ d ].prev = dead;
+            dead            = shift ( other_.dead );
+        }
+        live += other_.live;
+        other_ = spaghetti_stack{ };
+        return { nodes, frames };
+    }
+    // Merges other_ in, its trees stay trees of their own.
+    [[maybe_unused]] sax::pair<size_type, frame_size_type> merge ( spaghetti_stack && other_ ) {
+        return merge ( std::move ( other_ ), [] ( size_type ) noexcept { return nil; } );
+    }
+
+    private:
+    // The node and the frame accessors of the spaghetti_tree.
+    [[nodiscard]] node_type const & node_at ( size_type n_ ) const noexcept { return stack[ n_ ]; }
+    [[nodiscard]] segment_type const & frame_at ( frame_size_type i_ ) const noexcept { return frame[ i_ ]; }
+
+    // Returns true if node n_ keeps its value when it's popped, it's a branch point, shared (with
+    // Dedup), or below the mark of an active checkpoint, i.e. restored by a rollback.
+    [[nodiscard]] bool stays ( size_type n_ ) const noexcept {
+        return Dedup or nil != stack[ n_ ].child or ( not checkpoints.empty ( ) and n_ < checkpoints.back ( ).nodes );
+    }
+
+    // The free frames, and the dead node slots (of a vector-like storage), are lists threaded
+    // through the frames and nodes themselves. With a checkpoint active, only the frames and
+    // slots freed after it are reused.
+    template<typename Index>
+    [[nodiscard]] Index reusable ( Index head_, Index checkpoint_type::*mark_ ) const noexcept {
+        return checkpoints.empty ( ) or head_ != checkpoints.back ( ).*mark_ ? head_ : static_cast<Index> ( -1 );
+    }
+
+    // Drops the tail of stack i_, the node is released unless it stays as a branch point (or
+    // shared, with Dedup), the frame is freed once its segment is empty. A branch point that
+    // stays is flagged as popped, if it was the last child of a popped branch point, that one
+    // is released as well.
+    void pop_tail ( frame_size_type i_ ) {
+        log_frame ( i_ );
+        segment_type & f  = frame[ i_ ];
+        size_type const t = f.tail, p = stack[ t ].prev;
+        f.tail            = p;
+        if ( f.tail == f.prev_tail )
+            free_frame ( i_ );
+        if constexpr ( not Dedup ) {
+            if ( nil == stack[ t ].child ) {
+                unlink ( t );
+                release ( t );
+                release_popped ( p );
+            }
+            else {
+                log_link ( t );
+                stack[ t ].popped = true;
+            }
+        }
+    }
+
+    // Releases node n_, if it's a popped branch point without children (left), and so on, up
+    // the path.
+    void release_popped ( size_type n_ ) {
+        while ( nil != n_ and stack[ n_ ].popped and nil == stack[ n_ ].child ) {
+            size_type const p = stack[ n_ ].prev;
+            unlink ( n_ );
+            release ( n_ );
+            n_ = p;
+        }
+    }
+
+    void free_frame ( frame_size_type i_ ) {
+        log_frame ( i_ );
+        frame[ i_ ].tail = std::exchange ( free, i_ );
+    }
+
+    [[nodiscard]] frame_size_type new_frame ( segment_type const & s_ ) {
+        frame_size_type const i = reusable ( free, &checkpoint_type::free );
+        if ( frame_nil == i )
+            return push_frame ( s_ );
+        log_frame ( i );
+        free       = static_cast<frame_size_type> ( frame[ i ].tail );
+        frame[ i ] = s_;
+        return i;
+    }
+
+    // Appends a frame, frame_nil is not a valid frame index.
+    [[nodiscard]] frame_size_type push_frame ( segment_type const & s_ ) {
+        if ( HEDLEY_UNLIKELY ( frame_nil == frame.size ( ) ) )
+            throw std::length_error ( "spaghetti_stack: frame index overflow" );
+        frame.push_back ( s_ );
+        return frame.size ( ) - 1;
+    }
+
+    // Clears the spaghetti_stack, and reserves the arena for a bulk load of count_ nodes.
+    [[nodiscard]] size_type start_bulk_load ( std::size_t count_, [[maybe_unused]] std::size_t values_ ) {
+        static_assert ( not is_segmented_storage_v<spaghetti>, "bulk loading requires a vector-like storage" );
+        static_assert ( not Dedup, "a hash-consed spaghetti_stack is loaded through emplace" );
+        assert ( checkpoints.empty ( ) );
+        assert ( count_ == values_ );
+        if ( HEDLEY_UNLIKELY ( count_ >= nil ) )
+            throw std::length_error ( "spaghetti_stack: node index overflow" );
+        size_type const count = static_cast<size_type> ( count_ );
+        stack                 = spaghetti{ };
+        value_stack           = values{ };
+        frame                 = segment{ };
+        free                  = frame_nil;
+        dead                  = nil;
+        live                  = count;
+        stack.reserve ( count );
+        if constexpr ( SoA )
+            value_stack.reserve ( count );
+        return count;
+    }
+
+    // Stacks and links the nodes given in pre-order, returns their number.
+    template<typename DepthRange, typename ValueRange>
+    [[nodiscard]] size_type load_preorder ( DepthRange const & depths_, ValueRange const & values_ ) {
+        size_type const count = start_bulk_load ( std::size ( depths_ ), std::size ( values_ ) );
+        index_map last; // The last node seen at every depth, up to the current one.
+        auto d = std::begin ( depths_ );
+        auto v = std::begin ( values_ );
+        for ( size_type n = 0; n < count; ++n, ++d, ++v ) {
+            assert ( static_cast<std::size_t> ( *d ) <= static_cast<std::size_t> ( last.size ( ) ) );
+            size_type const prev = *d ? last[ *d - 1 ] : nil;
+            truncate ( last, static_cast<size_type> ( *d ) );
+            last.push_back ( n );
+            static_cast<void> ( stack_emplace ( prev, false, *v ) );
+            link ( stack, n );
+        }
+        return count;
+    }
+
+    // The frames of the count_ (> 0) nodes loaded in pre-order, the algorithms run under the
+    // execution policy, if one is given.
+    template<typename DepthRange, typename... ExecutionPolicy>
+    void preorder_frames ( DepthRange const & depths_, size_type count_, ExecutionPolicy &&... policy_ ) {
+        index_map run ( count_, 0 ); // Flags, then the inclusive scan of the flags.
+        auto const first = std::begin ( depths_ );
+        run[ 0 ]         = 1;
+        std::transform ( policy_..., std::next ( first ), std::next ( first, count_ ), first, std::next ( run.begin ( ) ),
+                         [] ( auto const d_, auto const prev_d_ ) { return static_cast<size_type> ( d_ != prev_d_ + 1 ); } );
+        std::inclusive_scan ( policy_..., run.begin ( ), run.end ( ), run.begin ( ) );
+        if ( HEDLEY_UNLIKELY ( run[ count_ - 1 ] > frame_nil ) )
+            throw std::length_error ( "spaghetti_stack: frame index overflow" );
+        frame.resize ( static_cast<frame_size_type> ( run[ count_ - 1 ] ) );
+        std::for_each ( policy_..., run.begin ( ), run.end ( ), [ & ] ( size_type const & r_ ) {
+            size_type const n = static_cast<size_type> ( &r_ - &run[ 0 ] );
+            if ( not n or run[ n - 1 ] != r_ )
+                frame[ r_ - 1 ].prev_tail = stack[ n ].prev;
+            if ( n == count_ - 1 or run[ n + 1 ] != r_ )
+                frame[ r_ - 1 ].tail = n;
+        } );
+    }
+
+    // Shrinks v_ to n_ elements, in O ( 1 ) if they're trivially destructible.
+    template<typename VectorLike>
+    static void truncate ( VectorLike & v_, size_type n_ ) noexcept {
+        using element_type = typename VectorLike::value_type;
+        if ( v_.size ( ) <= n_ )
+            return;
+        if constexpr ( requires { v_.shrink ( n_ ); } ) {
+            v_.shrink ( n_ );
+        }
+        else if constexpr ( std::is_trivially_destructible_v<element_type> and std::is_default_constructible_v<element_type> ) {
+            v_.resize ( n_ );
+        }
+        else {
+            while ( v_.size ( ) > n_ )
+                v_.pop_back ( );
+        }
+    }
+
+    // Save frame i_, or the links of node n_, to the undo log, if below the mark of the last
+    // checkpoint. A frame that was saved last, is not saved again.
+    void log_frame ( frame_size_type i_ ) {
+        if ( checkpoints.empty ( ) or i_ >= checkpoints.back ( ).frames )
+            return;
+        if ( frame_log.size ( ) > checkpoints.back ( ).frame_log and frame_log.back ( ).index == i_ )
+            return;
+        frame_log.push_back ( frame_undo_type{ i_, frame[ i_ ] } );
+    }
+    void log_link ( size_type n_ ) {
+        if ( checkpoints.empty ( ) or nil == n_ or n_ >= checkpoints.back ( ).nodes )
+            return;
+        link_log.push_back ( link_undo_type{ n_, stack[ n_ ] } );
+    }
+
+    [[nodiscard]] static std::uint64_t hash_node ( size_type prev_, const_reference v_ ) noexcept {
+        return static_cast<std::uint64_t> ( std::hash<value_type>{ }( v_ ) ) ^
+               static_cast<std::uint64_t> ( prev_ ) * 0x9e37'79b9'7f4a'7c15ull;
+    }
+
+    // Returns the node holding the value made of args_ on top of node prev_. Without Dedup,
+    // or if there is no such node, it's stacked (in a new segment if notch_) and linked.
+    template<typename... Args>
+    [[nodiscard]] size_type stack_node ( size_type prev_, bool notch_, Args &&... args_ ) {
+        if constexpr ( Dedup ) {
+            value_type v{ std::forward<Args> ( args_ )... };
+            std::uint64_t const h = hash_node ( prev_, v );
+            auto const equal      = [ & ] ( size_type n_ ) { return prev_ == stack[ n_ ].prev and v == value ( n_ ); };
+            if ( size_type const n = table.find ( h, equal ); nil != n )
+                return n;
+            size_type const n = stack_emplace ( prev_, notch_, std::move ( v ) );
+            ++live;
+            log_parent ( prev_ );
+            link ( stack, n );
+            table.insert ( h, n );
+            return n;
+        }
+        else {
+            size_type const n = stack_emplace ( prev_, notch_, std::forward<Args> ( args_ )... );
+            ++live;
+            log_parent ( prev_ );
+            link ( stack, n );
+            return n;
+        }
+    }
+
+    // Linking a child modifies the parent p_ and its first child.
+    void log_parent ( size_type p_ ) {
+        if ( nil != p_ ) {
+            log_link ( p_ );
+            log_link ( stack[ p_ ].child );
+        }
+    }
+
+    // Stacks a node on top of node prev_, in a new segment if notch_. Returns its index.
+    template<typename... Args>
+    [[nodiscard]] size_type stack_emplace ( size_type prev_, [[maybe_unused]] bool notch_, Args &&... args_ ) {
+        if constexpr ( is_segmented_storage_v<spaghetti> ) {
+            if ( notch_ )
+                return stack.emplace_segment ( link_type{ .prev = prev_ }, std::in_place, std::forward<Args> ( args_ )... );
+            return stack.emplace_on ( prev_, link_type{ .prev = prev_ }, std::in_place, std::forward<Args> ( args_ )... );
+        }
+        else if ( size_type const n = reusable ( dead, &checkpoint_type::dead ); nil != n ) {
+            dead = stack[ n ].prev;
+            std::destroy_at ( std::addressof ( stack[ n ] ) );
+            if constexpr ( SoA ) {
+                std::construct_at ( std::addressof ( stack[ n ] ), link_type{ .prev = prev_ } );
+                std::destroy_at ( std::addressof ( value_stack[ n ] ) );
+                new ( std::addressof ( value_stack[ n ] ) ) value_type{ std::forward<Args> ( args_ )... };
+            }
+            else {
+                std::construct_at ( std::addressof ( stack[ n ] ), link_type{ .prev = prev_ }, std::in_place,
+                                    std::forward<Args> ( args_ )... );
+            }
+            return n;
+        }
+        else if ( HEDLEY_UNLIKELY ( nil == tail_index ( ) ) ) {
+            throw std::length_error ( "spaghetti_stack: node index overflow" );
+        }
+        else if constexpr ( SoA ) {
+            value_stack.emplace_back ( std::forward<Args> ( args_ )... );
+            stack.emplace_back ( link_type{ .prev = prev_ } );
+            return tail_index ( ) - 1;
+        }
+        else {
+            stack.emplace_back ( link_type{ .prev = prev_ }, std::in_place, std::forward<Args> ( args_ )... );
+            return tail_index ( ) - 1;
+        }
+    }
+
+    // Give back the (unlinked) node n_ to the storage. The slot of a node below the mark of a
+    // checkpoint is reclaimed once that checkpoint is committed, it's dropped from the count of
+    // live nodes right away.
+    void release ( size_type n_ ) {
+        --live;
+        if constexpr ( is_segmented_storage_v<spaghetti> )
+            stack.release ( n_ );
+        else if ( checkpoints.empty ( ) or n_ >= checkpoints.back ( ).nodes )
+            reclaim ( n_ );
+        else
+            deferred.push_back ( n_ );
+    }
+
+    // A vector-like storage shrinks if n_ is on top, otherwise the slot goes on the list of
+    // dead nodes, through its prev.
+    void reclaim ( size_type n_ ) noexcept {
+        if ( n_ == tail_index ( ) - 1 ) {
+            stack.pop_back ( );
+            if constexpr ( SoA )
+                value_stack.pop_back ( );
+        }
+        else {
+            stack[ n_ ].prev = std::exchange ( dead, n_ );
+        }
+    }
+
+    // Links the new node n_ into the tree, sets its depth and jump pointer and prepends it to
+    // the children of its parent. The jump pointers are those of Myers' skew-binary scheme: if
+    // the jumps of the parent and of its jump cover equal distances, the new node jumps over
+    // both, otherwise it jumps to its parent. The distance covered by a jump depends on the
+    // depth only, any node reaches any ancestor in O ( log depth ) jumps.
+    static void link ( spaghetti & stack_, size_type n_ ) noexcept {
+        set_jump ( stack_, n_ );
+        node_type & n = stack_[ n_ ];
+        if ( size_type const p = n.prev; nil != p ) {
+            size_type const s = std::exchange ( stack_[ p ].child, n_ );
+            if ( nil != s )
+                stack_[ s ].prev_sibling = n_;
+            n.sibling = s;
+        }
+    }
+
+    // Sets the depth and the jump pointer of node n_, from those of its parent.
+    static void set_jump ( spaghetti & stack_, size_type n_ ) noexcept {
+        node_type & n = stack_[ n_ ];
+        if ( size_type const p = n.prev; nil != p ) {
+            node_type const & parent = stack_[ p ];
+            size_type const j = parent.jump, jj = stack_[ j ].jump;
+            n.depth           = parent.depth + 1;
+            n.jump            = parent.depth - stack_[ j ].depth == stack_[ j ].depth - stack_[ jj ].depth ? jj : p;
+        }
+        else {
+            n.depth = 0;
+            n.jump  = n_;
+        }
+    }
+
+    // Remove node n_ from the children of its parent, in O ( 1 ).
+    void unlink ( size_type n_ ) {
+        if ( nil == stack[ n_ ].prev )
+            return;
+        log_link ( n_ );
+        log_link ( stack[ n_ ].sibling );
+        log_link ( nil != stack[ n_ ].prev_sibling ? stack[ n_ ].prev_sibling : stack[ n_ ].prev );
+        node_type & n = stack[ n_ ];
+        if ( nil != n.prev_sibling )
+            stack[ n.prev_sibling ].sibling = n.sibling;
+        else
+            stack[ n.prev ].child = n.sibling;
+        if ( nil != n.sibling )
+            stack[ n.sibling ].prev_sibling = n.prev_sibling;
+        n.sibling = n.prev_sibling = nil;
+    }
+
+    spaghetti stack;
+    values value_stack;
+    node_table table;
+    segment frame = [] { return segment{ }; }( );
+    frame_size_type free = frame_nil;
+    size_type dead = nil, live = 0;
+    mi_vector<checkpoint_type, size_type> checkpoints;
+    mi_vector<frame_undo_type, size_type> frame_log;
+    mi_vector<link_undo_type, size_type> link_log;
+    mi_vector<size_type, size_type> deferred; // Releases of nodes below the mark of a checkpoint.
+};
+
+template<typename ValueType, typename SizeType>
+using stable_spaghetti_stack = spaghetti_stack<ValueType, SizeType, mi_chunked_vector>;
+template<typename ValueType, typename SizeType>
+using cactus_stack = spaghetti_stack<ValueType, SizeType, mi_cactus_vector>;
+template<typename ValueType, typename SizeType>
+using heap_stack = spaghetti_stack<ValueType, SizeType, mi_heap_vector>;
+template<typename ValueType, typename SizeType>
+using soa_spaghetti_stack = spaghetti_stack<ValueType, SizeType, mi_vector, true>;
+template<typename ValueType, typename SizeType>
+using dag_spaghetti_stack = spaghetti_stack<ValueType, SizeType, mi_vector, false, true>;
+
+// A spaghetti_stack per thread, merged into a shared one later. Every thread builds its
+// branches in a private instance, without contention, and merges them in with one bulk copy
+// under a lock. A branch can be forked off a node of the shared spaghetti_stack (of the shared
+// prefix), the merge attaches it to that node, the shared instance isn't touched before. The
+// stacks of the local instance are notched through fork_emplace ( ), and grown through
+// stack ( ). Stack is a spaghetti_stack that can be merged.
+template<typename Stack>
+struct local_spaghetti_stack {
+
+    using stack_type      = Stack;
+    using size_type       = typename Stack::size_type;
+    using frame_size_type = typename Stack::frame_size_type;
+    using reference       = typename Stack::reference;
+
+    // The local spaghetti_stack of the calling thread.
+    [[nodiscard]] static local_spaghetti_stack & local ( ) {
+        thread_local local_spaghetti_stack instance;
+        return instance;
+    }
+
+    // Notches a new stack in the local instance, forked off node n_ of the shared spaghetti_stack
+    // once merged, or a root if n_ is nil. Returns a reference to the stacked value and the
+    // (local) index of the stack.
+    template<typename... Args>
+    [[maybe_unused]] sax::pair<reference, frame_size_type> fork_emplace ( size_type n_, Args &&... args_ ) {
+        sax::pair<reference, frame_size_type> const r = object.notch_emplace ( std::forward<Args> ( args_ )... );
+        size_type const root                          = object.tail ( r.second );
+        while ( attach.size ( ) <= root )
+            attach.push_back ( Stack::nil );
+        attach[ root ] = n_;
+        return r;
+    }
+
+    [[nodiscard]] stack_type & stack ( ) noexcept { return object; }
+    [[nodiscard]] stack_type const & stack ( ) const noexcept { return object; }
+
+    // Merges the local instance into shared_, holding mutex_, and leaves it empty. Returns the
+    // offsets that relocate the local node and frame indices to those of shared_.
+    [[maybe_unused]] sax::pair<size_type, frame_size_type> merge_into ( stack_type & shared_, std::mutex & mutex_ ) {
+        std::scoped_lock const lock ( mutex_ );
+        sax::pair<size_type, frame_size_type> const offsets = shared_.merge ( std::move ( object ), [ this ] ( size_type r_ ) {
+            return r_ < attach.size ( ) ? attach[ r_ ] : Stack::nil;
+        } );
+        attach.clear ( );
+        return offsets;
+    }
+
+    private:
+    stack_type object;
+    mi_vector<size_type, size_type> attach; // The shared node a local root is forked off, by root.
+};
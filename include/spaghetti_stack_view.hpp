@@ -0,0 +1,250 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+
+#include "detail/hedley.hpp"
+#include "detail/mapped_file.hpp"
+#include "detail/spaghetti_tree.hpp"
+#include "spaghetti_stack.hpp"
+
+// An image of a spaghetti_stack is a flat file, a header followed by the raw arrays of the
+// nodes, the frames and (with SoA) the values, each aligned to 64 bytes. All links are
+// indices, the image holds no pointers and is used in place where it's mapped, without
+// parsing or copying. Dead node slots and free frames are written as they are, the free
+// lists threaded through them are kept. The header records the sizes of the node, value and
+// index types, a view of other types fails to open the image. The byte order is that of the
+// machine that wrote the image. Images require a contiguous (mi_vector) storage and a
+// trivially copyable value_type, a hash-consed spaghetti_stack is written without its table.
+struct spaghetti_image {
+
+    struct header_type {
+        std::uint64_t magic;
+        std::uint32_t version, soa;
+        std::uint32_t node_size, value_size, size_type_size, frame_size_type_size;
+        std::uint64_t nodes, frames, live, free, dead;
+        std::uint64_t node_offset, frame_offset, value_offset, file_size;
+    };
+
+    static constexpr std::uint64_t magic     = 0x4547'414d'4953'5053; // "SPSIMAGE"
+    static constexpr std::uint32_t version   = 1;
+    static constexpr std::uint64_t alignment = 64;
+
+    template<typename Stack>
+    using node_type = typename Stack::node_type;
+    template<typename Stack>
+    using segment_type = typename Stack::segment_type;
+
+    // The header of an image of nodes_ nodes and frames_ frames, the fields that depend on the
+    // contents of the spaghetti_stack (live, free and dead) left at zero.
+    template<typename Stack>
+    [[nodiscard]] static constexpr header_type header ( std::uint64_t nodes_, std::uint64_t frames_ ) noexcept {
+        constexpr bool soa = not std::is_same_v<node_type<Stack>, typename Stack::spaghetti_type>;
+        header_type h{ };
+        h.magic                = magic;
+        h.version              = version;
+        h.soa                  = soa;
+        h.node_size            = sizeof ( node_type<Stack> );
+        h.value_size           = sizeof ( typename Stack::value_type );
+        h.size_type_size       = sizeof ( typename Stack::size_type );
+        h.frame_size_type_size = sizeof ( typename Stack::frame_size_type );
+        h.nodes                = nodes_;
+        h.frames               = frames_;
+        h.node_offset          = align ( sizeof ( header_type ) );
+        h.frame_offset         = align ( h.node_offset + nodes_ * sizeof ( node_type<Stack> ) );
+        h.value_offset         = align ( h.frame_offset + frames_ * sizeof ( segment_type<Stack> ) );
+        h.file_size            = soa ? h.value_offset + nodes_ * sizeof ( typename Stack::value_type )
+                                     : h.frame_offset + frames_ * sizeof ( segment_type<Stack> );
+        return h;
+    }
+
+    // Writes the image of s_ to the file path_, throws std::runtime_error on failure.
+    template<typename Stack>
+    static void save ( Stack const & s_, std::filesystem::path const & path_ ) {
+        using value_type = typename Stack::value_type;
+        static_assert ( std::is_same_v<typename Stack::spaghetti, mi_vector<node_type<Stack>, typename Stack::size_type>>,
+                        "an image requires a contiguous (mi_vector) storage" );
+        static_assert ( std::is_trivially_copyable_v<value_type>, "an image requires a trivially copyable value_type" );
+        header_type h = header<Stack> ( s_.tail_index ( ), s_.size ( ) );
+        h.live        = s_.live;
+        h.free        = s_.free;
+        h.dead        = s_.dead;
+        std::ofstream out ( path_, std::ios::binary | std::ios::trunc );
+        if ( HEDLEY_UNLIKELY ( not out ) )
+            throw std::runtime_error ( "spaghetti_image: can't open file" );
+        auto const write = [ & ] ( void const * p_, std::uint64_t offset_, std::uint64_t bytes_ ) {
+            while ( static_cast<std::uint64_t> ( out.tellp ( ) ) < offset_ )
+                out.put ( 0 );
+            if ( bytes_ )
+                out.write ( static_cast<char const *> ( p_ ), static_cast<std::streamsize> ( bytes_ ) );
+        };
+        write ( &h, 0, sizeof ( header_type ) );
+        write ( s_.stack.data ( ), h.node_offset, h.nodes * sizeof ( node_type<Stack> ) );
+        write ( s_.frame.data ( ), h.frame_offset, h.frames * sizeof ( segment_type<Stack> ) );
+        if constexpr ( not std::is_same_v<node_type<Stack>, typename Stack::spaghetti_type> )
+            write ( s_.value_stack.data ( ), h.value_offset, h.nodes * sizeof ( value_type ) );
+        out.flush ( );
+        if ( HEDLEY_UNLIKELY ( not out ) )
+            throw std::runtime_error ( "spaghetti_image: can't write file" );
+    }
+
+    private:
+    [[nodiscard]] static constexpr std::uint64_t align ( std::uint64_t offset_ ) noexcept {
+        return ( offset_ + alignment - 1 ) & ~( alignment - 1 );
+    }
+};
+
+// Writes the image of s_ to the file path_, to be opened by a spaghetti_stack_view.
+template<typename ValueType, typename SizeType, bool SoA, bool Dedup, typename FrameSizeType>
+void save_image ( spaghetti_stack<ValueType, SizeType, mi_vector, SoA, Dedup, FrameSizeType> const & s_,
+                  std::filesystem::path const & path_ ) {
+    spaghetti_image::save ( s_, path_ );
+}
+
+// A read-only spaghetti_stack over a mapped image, the pages of the image are read in as
+// they're touched. The view reads the images of spaghetti_stacks with the same template
+// arguments (Dedup aside), its interface is the const part of that of spaghetti_stack, node
+// and frame indices are those of the spaghetti_stack the image was taken of. Opening an
+// image that isn't one, or one of other types, throws std::runtime_error.
+template<typename ValueType, typename SizeType, bool SoA = false, typename FrameSizeType = SizeType>
+struct spaghetti_stack_view
+    : detail::spaghetti_tree<spaghetti_stack_view<ValueType, SizeType, SoA, FrameSizeType>, ValueType, SizeType, FrameSizeType,
+                             SoA> {
+
+    using stack_type = spaghetti_stack<ValueType, SizeType, mi_vector, SoA, false, FrameSizeType>;
+
+    using value_type      = ValueType;
+    using size_type       = SizeType;
+    using frame_size_type = FrameSizeType;
+    using const_pointer   = value_type const *;
+    using const_reference = value_type const &;
+
+    private:
+    using tree_type = detail::spaghetti_tree<spaghetti_stack_view, ValueType, SizeType, FrameSizeType, SoA>;
+    friend tree_type;
+
+    using node_type    = spaghetti_image::node_type<stack_type>;
+    using segment_type = spaghetti_image::segment_type<stack_type>;
+
+    static_assert ( std::is_trivially_copyable_v<value_type>, "an image requires a trivially copyable value_type" );
+    static_assert ( alignof ( node_type ) <= spaghetti_image::alignment and alignof ( value_type ) <= spaghetti_image::alignment );
+
+    public:
+    using tree_type::frame_nil;
+    using tree_type::nil;
+
+    explicit spaghetti_stack_view ( std::filesystem::path const & path_ ) : file{ path_ } {
+        if ( HEDLEY_UNLIKELY ( file.size ( ) < sizeof ( spaghetti_image::header_type ) ) )
+            throw std::runtime_error ( "spaghetti_stack_view: not an image" );
+        spaghetti_image::header_type const & h = *reinterpret_cast<spaghetti_image::header_type const *> ( file.data ( ) );
+        spaghetti_image::header_type const t   = spaghetti_image::header<stack_type> ( 0, 0 );
+        if ( HEDLEY_UNLIKELY ( t.magic != h.magic or t.version != h.version ) )
+            throw std::runtime_error ( "spaghetti_stack_view: not an image" );
+        if ( HEDLEY_UNLIKELY ( t.soa != h.soa or t.node_size != h.node_size or t.value_size != h.value_size or
+                               t.size_type_size != h.size_type_size or t.frame_size_type_size != h.frame_size_type_size ) )
+            throw std::runtime_error ( "spaghetti_stack_view: image of other types" );
+        // Every array fits in the file, such that the layout of the image computes without overflow.
+        std::uint64_t const bytes = file.size ( );
+        if ( HEDLEY_UNLIKELY ( h.nodes > bytes / sizeof ( node_type ) or h.frames > bytes / sizeof ( segment_type ) or
+                               ( SoA and h.nodes > bytes / sizeof ( value_type ) ) ) )
+            throw std::runtime_error ( "spaghetti_stack_view: truncated image" );
+        // The arrays are located through the layout computed from the sizes, not through the
+        // offsets in the file, which have to agree with it.
+        spaghetti_image::header_type const e = spaghetti_image::header<stack_type> ( h.nodes, h.frames );
+        if ( HEDLEY_UNLIKELY ( e.node_offset != h.node_offset or e.frame_offset != h.frame_offset or
+                               e.value_offset != h.value_offset or e.file_size != h.file_size or h.nodes > nil or
+                               h.frames > frame_nil or h.live > h.nodes ) )
+            throw std::runtime_error ( "spaghetti_stack_view: corrupt image" );
+        if ( HEDLEY_UNLIKELY ( e.file_size > bytes ) )
+            throw std::runtime_error ( "spaghetti_stack_view: truncated image" );
+        node_data  = reinterpret_cast<node_type const *> ( file.data ( ) + e.node_offset );
+        frame_data = reinterpret_cast<segment_type const *> ( file.data ( ) + e.frame_offset );
+        if constexpr ( SoA )
+            value_data = reinterpret_cast<value_type const *> ( file.data ( ) + e.value_offset );
+        nodes  = static_cast<size_type> ( h.nodes );
+        frames = static_cast<frame_size_type> ( h.frames );
+        live   = static_cast<size_type> ( h.live );
+    }
+
+    // Returns the number of spaghetti-stacks (frames, free frames included).
+    [[nodiscard]] frame_size_type size ( ) const noexcept { return frames; }
+    // Returns the number of nodes in the image, dead slots included.
+    [[nodiscard]] size_type tail_index ( ) const noexcept { return nodes; }
+    // Returns the number of live nodes.
+    [[nodiscard]] size_type node_count ( ) const noexcept { return live; }
+
+    [[nodiscard]] bool validate_tail ( frame_size_type i_ ) const noexcept { return i_ < frames; }
+
+    [[nodiscard]] const_reference value ( size_type n_ ) const noexcept {
+        if constexpr ( SoA )
+            return value_data[ n_ ];
+        else
+            return node_data[ n_ ].value;
+    }
+    [[nodiscard]] const_reference operator[] ( frame_size_type i_ ) const noexcept { return value ( tail ( i_ ) ); }
+
+    // Children, paths and ancestors, those of the spaghetti_tree, as with the spaghetti_stack.
+
+    using tree_type::children;
+    using tree_type::find_child;
+    using tree_type::next_sibling;
+
+    using path_iterator = typename tree_type::template path_iterator<true>;
+    using path_range    = typename tree_type::template path_range<true>;
+
+    using tree_type::branch;
+    using tree_type::path;
+
+    using tree_type::ancestor_at;
+    using tree_type::depth;
+    using tree_type::is_ancestor;
+    using tree_type::lca;
+    using tree_type::level_ancestor;
+    using tree_type::prev;
+    using tree_type::tail;
+
+    using tree_type::frame_size;
+    using tree_type::stack_depth;
+
+    private:
+    // The node and the frame accessors of the spaghetti_tree.
+    [[nodiscard]] node_type const & node_at ( size_type n_ ) const noexcept { return node_data[ n_ ]; }
+    [[nodiscard]] segment_type const & frame_at ( frame_size_type i_ ) const noexcept { return frame_data[ i_ ]; }
+
+    detail::mapped_file file;
+    node_type const * node_data     = nullptr;
+    segment_type const * frame_data = nullptr;
+    value_type const * value_data   = nullptr;
+    size_type nodes                 = 0;
+    frame_size_type frames          = 0;
+    size_type live                  = 0;
+};
@@ -0,0 +1,771 @@
+
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#define USE_MIMALLOC_LTO 1
+
+#include <pector/malloc_allocator.h>
+#include <pector/mimalloc_allocator.h>
+#include <pector/pector.h>
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits> // true_type
+#include <utility>
+
+#include "detail/hedley.hpp"
+#include "detail/virtual_memory.hpp"
+
+template<class T>
+struct xmi_stl_allocator {
+
+    using value_type = T;
+
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap            = std::true_type;
+    using is_always_equal                        = std::true_type;
+
+    xmi_stl_allocator ( ) mi_attr_noexcept {}
+    xmi_stl_allocator ( const xmi_stl_allocator & ) mi_attr_noexcept {}
+    template<class U>
+    xmi_stl_allocator ( const xmi_stl_allocator<U> & ) mi_attr_noexcept {}
+
+    void deallocate ( T * p, size_t /* count */ ) { mi_free ( p ); }
+    T * allocate ( size_t count ) { return ( T * ) mi_new_n ( count, sizeof ( T ) ); }
+};
+
+template<class T1, class T2>
+bool operator== ( const xmi_stl_allocator<T1> &, const xmi_stl_allocator<T2> & ) mi_attr_noexcept {
+    return true;
+}
+template<class T1, class T2>
+bool operator!= ( const xmi_stl_allocator<T1> &, const xmi_stl_allocator<T2> & ) mi_attr_noexcept {
+    return false;
+}
+
+template<typename T, typename S>
+using mi_vector = pt::pector<T, xmi_stl_allocator<T>, S, pt::default_recommended_size, false>;
+
+// A vector-like container that stores its elements in fixed-size chunks, found through a
+// (small) chunk directory. Growing it allocates a new chunk, but never moves the existing
+// elements, references to elements stay valid until the element is popped.
+template<typename T, typename S, std::size_t ChunkShift = 12, typename Allocator = xmi_stl_allocator<T>>
+struct chunked_vector {
+
+    using value_type      = T;
+    using size_type       = S;
+    using difference_type = std::make_signed_t<size_type>;
+    using allocator_type  = Allocator;
+
+    using pointer         = value_type *;
+    using const_pointer   = value_type const *;
+    using reference       = value_type &;
+    using const_reference = value_type const &;
+
+    static constexpr size_type chunk_shift = static_cast<size_type> ( ChunkShift );
+    static constexpr size_type chunk_size  = size_type{ 1 } << chunk_shift;
+    static constexpr size_type chunk_mask  = chunk_size - 1;
+
+    private:
+    using directory = mi_vector<pointer, size_type>;
+
+    template<typename Container, typename Value>
+    struct chunked_iterator {
+
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type        = std::remove_const_t<Value>;
+        using difference_type   = typename chunked_vector::difference_type;
+        using pointer           = Value *;
+        using reference         = Value &;
+
+        chunked_iterator ( ) noexcept = default;
+        chunked_iterator ( Container * c_, size_type i_ ) noexcept : container{ c_ }, index{ i_ } {}
+
+        [[nodiscard]] reference operator* ( ) const noexcept { return ( *container )[ index ]; }
+        [[nodiscard]] pointer operator-> ( ) const noexcept { return std::addressof ( ( *container )[ index ] ); }
+        [[nodiscard]] reference operator[] ( difference_type n_ ) const noexcept { return *( *this + n_ ); }
+
+        chunked_iterator & operator++ ( ) noexcept { return ++index, *this; }
+        chunked_iterator & operator-- ( ) noexcept { return --index, *this; }
+        chunked_iterator operator++ ( int ) noexcept { return { container, index++ }; }
+        chunked_iterator operator-- ( int ) noexcept { return { container, index-- }; }
+        chunked_iterator & operator+= ( difference_type n_ ) noexcept { return index += n_, *this; }
+        chunked_iterator & operator-= ( difference_type n_ ) noexcept { return index -= n_, *this; }
+
+        [[nodiscard]] friend chunked_iterator operator+ ( chunked_iterator it_, difference_type n_ ) noexcept { return it_ += n_; }
+        [[nodiscard]] friend chunked_iterator operator+ ( difference_type n_, chunked_iterator it_ ) noexcept { return it_ += n_; }
+        [[nodiscard]] friend chunked_iterator operator- ( chunked_iterator it_, difference_type n_ ) noexcept { return it_ -= n_; }
+        [[nodiscard]] friend difference_type operator- ( chunked_iterator const & l_, chunked_iterator const & r_ ) noexcept {
+            return static_cast<difference_type> ( l_.index ) - static_cast<difference_type> ( r_.index );
+        }
+
+        [[nodiscard]] bool operator== ( chunked_iterator const & r_ ) const noexcept { return index == r_.index; }
+        [[nodiscard]] bool operator!= ( chunked_iterator const & r_ ) const noexcept { return index != r_.index; }
+        [[nodiscard]] bool operator< ( chunked_iterator const & r_ ) const noexcept { return index < r_.index; }
+        [[nodiscard]] bool operator> ( chunked_iterator const & r_ ) const noexcept { return index > r_.index; }
+        [[nodiscard]] bool operator<= ( chunked_iterator const & r_ ) const noexcept { return index <= r_.index; }
+        [[nodiscard]] bool operator>= ( chunked_iterator const & r_ ) const noexcept { return index >= r_.index; }
+
+        Container * container = nullptr;
+        size_type index       = 0;
+    };
+
+    public:
+    using iterator               = chunked_iterator<chunked_vector, value_type>;
+    using const_iterator         = chunked_iterator<chunked_vector const, value_type const>;
+    using reverse_iterator       = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+    chunked_vector ( ) noexcept = default;
+    chunked_vector ( chunked_vector const & o_ ) {
+        reserve ( o_.m_size );
+        for ( size_type i = 0; i < o_.m_size; ++i )
+            emplace_back ( o_[ i ] );
+    }
+    chunked_vector ( chunked_vector && o_ ) noexcept { swap ( o_ ); }
+
+    ~chunked_vector ( ) noexcept {
+        clear ( );
+        for ( pointer c : chunks )
+            allocator_type{ }.deallocate ( c, chunk_size );
+    }
+
+    chunked_vector & operator= ( chunked_vector const & o_ ) {
+        if ( this != std::addressof ( o_ ) ) {
+            chunked_vector tmp{ o_ };
+            swap ( tmp );
+        }
+        return *this;
+    }
+    chunked_vector & operator= ( chunked_vector && o_ ) noexcept {
+        swap ( o_ );
+        return *this;
+    }
+
+    void swap ( chunked_vector & o_ ) noexcept {
+        std::swap ( chunks, o_.chunks );
+        std::swap ( m_size, o_.m_size );
+    }
+
+    template<typename... Args>
+    reference emplace_back ( Args &&... args_ ) {
+        if ( HEDLEY_UNLIKELY ( m_size == capacity ( ) ) )
+            chunks.push_back ( allocator_type{ }.allocate ( chunk_size ) );
+        pointer p = new ( std::addressof ( ( *this )[ m_size ] ) ) value_type{ std::forward<Args> ( args_ )... };
+        ++m_size;
+        return *p;
+    }
+    reference push_back ( const_reference v_ ) { return emplace_back ( v_ ); }
+    reference push_back ( value_type && v_ ) { return emplace_back ( std::move ( v_ ) ); }
+
+    // The chunk is kept, a following emplace_back does not allocate.
+    void pop_back ( ) noexcept {
+        assert ( m_size );
+        std::destroy_at ( std::addressof ( back ( ) ) );
+        --m_size;
+    }
+
+    void clear ( ) noexcept { shrink ( 0 ); }
+
+    // Destroys the elements past the first n_, the chunks are kept.
+    void shrink ( size_type n_ ) noexcept {
+        assert ( n_ <= m_size );
+        if constexpr ( std::is_trivially_destructible_v<value_type> )
+            m_size = n_;
+        else
+            while ( m_size > n_ )
+                pop_back ( );
+    }
+
+    void reserve ( size_type n_ ) {
+        while ( capacity ( ) < n_ )
+            chunks.push_back ( allocator_type{ }.allocate ( chunk_size ) );
+    }
+
+    [[nodiscard]] reference operator[] ( size_type i_ ) noexcept { return chunks[ i_ >> chunk_shift ][ i_ & chunk_mask ]; }
+    [[nodiscard]] const_reference operator[] ( size_type i_ ) const noexcept {
+        return chunks[ i_ >> chunk_shift ][ i_ & chunk_mask ];
+    }
+
+    [[nodiscard]] reference front ( ) noexcept { return ( *this )[ 0 ]; }
+    [[nodiscard]] const_reference front ( ) const noexcept { return ( *this )[ 0 ]; }
+    [[nodiscard]] reference back ( ) noexcept { return ( *this )[ m_size - 1 ]; }
+    [[nodiscard]] const_reference back ( ) const noexcept { return ( *this )[ m_size - 1 ]; }
+
+    [[nodiscard]] size_type size ( ) const noexcept { return m_size; }
+    [[nodiscard]] size_type capacity ( ) const noexcept { return static_cast<size_type> ( chunks.size ( ) ) << chunk_shift; }
+    [[nodiscard]] bool empty ( ) const noexcept { return not m_size; }
+
+    [[nodiscard]] iterator begin ( ) noexcept { return { this, 0 }; }
+    [[nodiscard]] const_iterator begin ( ) const noexcept { return { this, 0 }; }
+    [[nodiscard]] const_iterator cbegin ( ) const noexcept { return begin ( ); }
+    [[nodiscard]] iterator end ( ) noexcept { return { this, m_size }; }
+    [[nodiscard]] const_iterator end ( ) const noexcept { return { this, m_size }; }
+    [[nodiscard]] const_iterator cend ( ) const noexcept { return end ( ); }
+
+    [[nodiscard]] reverse_iterator rbegin ( ) noexcept { return reverse_iterator{ end ( ) }; }
+    [[nodiscard]] const_reverse_iterator rbegin ( ) const noexcept { return const_reverse_iterator{ end ( ) }; }
+    [[nodiscard]] reverse_iterator rend ( ) noexcept { return reverse_iterator{ begin ( ) }; }
+    [[nodiscard]] const_reverse_iterator rend ( ) const noexcept { return const_reverse_iterator{ begin ( ) }; }
+
+    private:
+    directory chunks;
+    size_type m_size = 0;
+};
+
+// A segmented storage, every stack (branch) gets its own region of 2^RegionShift elements
+// of reserved address space, of which pages are committed as the stack grows. A node index
+// is the pair [region, offset] packed as ( region << RegionShift ) | offset. Pushing onto
+// a stack is a bump of the top of its region, nodes of a stack are contiguous in memory.
+// A region that runs empty is decommitted (but for its first page) and recycled. Growing a
+// region past 2^RegionShift elements, or the number of regions onto nil, throws
+// std::length_error.
+//
+// A node that is released below the top of its region (a popped branch point) stays in
+// place, as a hole, until the region shrinks down to it.
+template<typename T, typename S, std::size_t RegionShift = 20>
+struct cactus_vector {
+
+    static_assert ( RegionShift < sizeof ( S ) * 8, "the region (shift) is too large for the size type" );
+
+    using value_type      = T;
+    using size_type       = S;
+    using difference_type = std::make_signed_t<size_type>;
+
+    using pointer         = value_type *;
+    using const_pointer   = value_type const *;
+    using reference       = value_type &;
+    using const_reference = value_type const &;
+
+    static constexpr size_type region_shift = static_cast<size_type> ( RegionShift );
+    static constexpr size_type region_size  = size_type{ 1 } << region_shift;
+    static constexpr size_type region_mask  = region_size - 1;
+
+    private:
+    struct region_type {
+        pointer base       = nullptr;
+        size_type top      = 0;
+        std::size_t commit = 0; // Committed bytes.
+    };
+
+    using regions = mi_vector<region_type, size_type>;
+    using list    = mi_vector<size_type, size_type>;
+
+    static constexpr std::size_t region_bytes = std::size_t{ region_size } * sizeof ( value_type );
+
+    template<typename Container, typename Value>
+    struct cactus_iterator {
+
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = std::remove_const_t<Value>;
+        using difference_type   = typename cactus_vector::difference_type;
+        using pointer           = Value *;
+        using reference         = Value &;
+
+        cactus_iterator ( ) noexcept = default;
+        cactus_iterator ( Container * c_, size_type r_, size_type o_ ) noexcept : container{ c_ }, region{ r_ }, offset{ o_ } {
+            skip ( );
+        }
+
+        [[nodiscard]] reference operator* ( ) const noexcept { return container->storage[ region ].base[ offset ]; }
+        [[nodiscard]] pointer operator-> ( ) const noexcept { return container->storage[ region ].base + offset; }
+
+        cactus_iterator & operator++ ( ) noexcept {
+            ++offset;
+            skip ( );
+            return *this;
+        }
+        cactus_iterator operator++ ( int ) noexcept {
+            cactus_iterator tmp = *this;
+            ++*this;
+            return tmp;
+        }
+
+        [[nodiscard]] bool operator== ( cactus_iterator const & r_ ) const noexcept {
+            return region == r_.region and offset == r_.offset;
+        }
+        [[nodiscard]] bool operator!= ( cactus_iterator const & r_ ) const noexcept { return not( *this == r_ ); }
+
+        private:
+        // Advance past the end of (empty) regions.
+        void skip ( ) noexcept {
+            while ( region < container->storage.size ( ) and offset == container->storage[ region ].top )
+                ++region, offset = 0;
+        }
+
+        Container * container = nullptr;
+        size_type region = 0, offset = 0;
+    };
+
+    public:
+    using iterator               = cactus_iterator<cactus_vector, value_type>;
+    using const_iterator         = cactus_iterator<cactus_vector const, value_type const>;
+    using reverse_iterator       = void; // Not supported.
+    using const_reverse_iterator = void;
+
+    cactus_vector ( ) noexcept = default;
+    cactus_vector ( cactus_vector const & ) = delete;
+    cactus_vector ( cactus_vector && o_ ) noexcept { swap ( o_ ); }
+
+    ~cactus_vector ( ) noexcept {
+        for ( region_type & r : storage ) {
+            std::destroy_n ( r.base, r.top );
+            detail::vm::release ( r.base, region_bytes );
+        }
+    }
+
+    cactus_vector & operator= ( cactus_vector const & ) = delete;
+    cactus_vector & operator= ( cactus_vector && o_ ) noexcept {
+        swap ( o_ );
+        return *this;
+    }
+
+    void swap ( cactus_vector & o_ ) noexcept {
+        std::swap ( storage, o_.storage );
+        std::swap ( free, o_.free );
+        std::swap ( holes, o_.holes );
+        std::swap ( m_size, o_.m_size );
+    }
+
+    // Constructs the first element of a new region, returns its index.
+    template<typename... Args>
+    [[nodiscard]] size_type emplace_segment ( Args &&... args_ ) {
+        size_type r;
+        if ( free.empty ( ) ) {
+            r = storage.size ( );
+            // The last region would hand out nil.
+            if ( HEDLEY_UNLIKELY ( r >= ( size_type{ 1 } << ( sizeof ( size_type ) * 8 - region_shift ) ) - 1 ) )
+                throw std::length_error ( "cactus_vector: region index overflow" );
+            storage.push_back ( region_type{ static_cast<pointer> ( detail::vm::reserve ( region_bytes ) ), 0, 0 } );
+        }
+        else {
+            r = free.back ( );
+            free.pop_back ( );
+        }
+        return construct ( r, std::forward<Args> ( args_ )... );
+    }
+
+    // Constructs an element on top of the region of node n_, returns its index.
+    template<typename... Args>
+    [[nodiscard]] size_type emplace_on ( size_type n_, Args &&... args_ ) {
+        return construct ( n_ >> region_shift, std::forward<Args> ( args_ )... );
+    }
+
+    // Destroys node n_, if it's on top of its region, the region shrinks, past the released
+    // nodes right below it. A node that is not on top stays in place, as a hole, until then.
+    void release ( size_type n_ ) {
+        region_type & r = storage[ n_ >> region_shift ];
+        --m_size;
+        auto h = std::lower_bound ( holes.begin ( ), holes.end ( ), n_ );
+        if ( ( n_ & region_mask ) != r.top - 1 ) {
+            holes.insert ( h, n_ );
+            return;
+        }
+        std::destroy_at ( r.base + --r.top );
+        auto const e = h;
+        for ( ; h != holes.begin ( ) and r.top and *( h - 1 ) == ( ( n_ & ~region_mask ) | ( r.top - 1 ) ); --h )
+            std::destroy_at ( r.base + --r.top );
+        holes.erase ( h, e );
+        if ( not r.top ) {
+            // Keep the first page, a recycled region starts without a page fault or a commit.
+            if ( std::size_t const p = detail::vm::page_size ( ); r.commit > p ) {
+                detail::vm::decommit ( reinterpret_cast<char *> ( r.base ) + p, r.commit - p );
+                r.commit = p;
+            }
+            free.push_back ( n_ >> region_shift );
+        }
+    }
+
+    [[nodiscard]] reference operator[] ( size_type i_ ) noexcept { return storage[ i_ >> region_shift ].base[ i_ & region_mask ]; }
+    [[nodiscard]] const_reference operator[] ( size_type i_ ) const noexcept {
+        return storage[ i_ >> region_shift ].base[ i_ & region_mask ];
+    }
+
+    // The number of (live) elements, over all regions.
+    [[nodiscard]] size_type size ( ) const noexcept { return m_size; }
+    [[nodiscard]] bool empty ( ) const noexcept { return not m_size; }
+
+    [[nodiscard]] iterator begin ( ) noexcept { return { this, 0, 0 }; }
+    [[nodiscard]] const_iterator begin ( ) const noexcept { return { this, 0, 0 }; }
+    [[nodiscard]] iterator end ( ) noexcept { return { this, storage.size ( ), 0 }; }
+    [[nodiscard]] const_iterator end ( ) const noexcept { return { this, storage.size ( ), 0 }; }
+
+    private:
+    template<typename... Args>
+    [[nodiscard]] size_type construct ( size_type r_, Args &&... args_ ) {
+        region_type & r = storage[ r_ ];
+        if ( HEDLEY_UNLIKELY ( r.top == region_size ) )
+            throw std::length_error ( "cactus_vector: region overflow" );
+        if ( std::size_t const need = ( std::size_t{ r.top } + 1 ) * sizeof ( value_type ); HEDLEY_UNLIKELY ( need > r.commit ) ) {
+            // Grow the committed part geometrically, starting at a page.
+            std::size_t const c =
+                std::min ( region_bytes, detail::vm::round_up_to_page ( std::max ( need, r.commit * 2 ) ) );
+            detail::vm::commit ( reinterpret_cast<char *> ( r.base ) + r.commit, c - r.commit );
+            r.commit = c;
+        }
+        new ( r.base + r.top ) value_type{ std::forward<Args> ( args_ )... };
+        ++m_size;
+        return ( r_ << region_shift ) | r.top++;
+    }
+
+    regions storage;
+    list free, holes; // Holes are sorted.
+    size_type m_size = 0;
+};
+
+// Rounds up to the size class of an allocation of bytes_, multiples of 16 up to 128 and
+// powers of 2 beyond that.
+[[nodiscard]] constexpr std::size_t size_class ( std::size_t bytes_ ) noexcept {
+    if ( bytes_ <= 128 )
+        return ( bytes_ + 15 ) & ~std::size_t{ 15 };
+    std::size_t c = 256;
+    while ( c < bytes_ )
+        c <<= 1;
+    return c;
+}
+
+// A pool of blocks of BlockSize bytes, allocated in slabs of 2^SlabShift blocks, on top of
+// xmi_stl_allocator. A block is identified by its index, free blocks form an (intrusive)
+// list through their first bytes.
+template<std::size_t BlockSize, typename S, std::size_t SlabShift = 10>
+struct size_class_pool {
+
+    static_assert ( BlockSize >= sizeof ( S ) and not( BlockSize % 16 ), "BlockSize is not a size class" );
+
+    using size_type = S;
+
+    static constexpr std::size_t block_size = BlockSize;
+    static constexpr size_type slab_shift   = static_cast<size_type> ( SlabShift );
+    static constexpr size_type slab_size    = size_type{ 1 } << slab_shift;
+    static constexpr size_type slab_mask    = slab_size - 1;
+
+    static constexpr size_type nil = static_cast<size_type> ( -1 );
+
+    private:
+    using allocator = xmi_stl_allocator<std::byte>;
+    using slabs     = mi_vector<std::byte *, size_type>;
+
+    public:
+    size_class_pool ( ) noexcept = default;
+    size_class_pool ( size_class_pool const & ) = delete;
+    size_class_pool ( size_class_pool && o_ ) noexcept { swap ( o_ ); }
+
+    ~size_class_pool ( ) noexcept {
+        for ( std::byte * p : storage )
+            allocator{ }.deallocate ( p, std::size_t{ slab_size } * block_size );
+    }
+
+    size_class_pool & operator= ( size_class_pool const & ) = delete;
+    size_class_pool & operator= ( size_class_pool && o_ ) noexcept {
+        swap ( o_ );
+        return *this;
+    }
+
+    void swap ( size_class_pool & o_ ) noexcept {
+        std::swap ( storage, o_.storage );
+        std::swap ( free, o_.free );
+        std::swap ( m_capacity, o_.m_capacity );
+    }
+
+    [[nodiscard]] size_type allocate ( ) {
+        if ( HEDLEY_LIKELY ( nil != free ) ) {
+            size_type const b = free;
+            free              = *reinterpret_cast<size_type *> ( address ( b ) );
+            return b;
+        }
+        if ( HEDLEY_UNLIKELY ( not( m_capacity & slab_mask ) ) )
+            storage.push_back ( allocator{ }.allocate ( std::size_t{ slab_size } * block_size ) );
+        return m_capacity++;
+    }
+
+    void deallocate ( size_type b_ ) noexcept {
+        *reinterpret_cast<size_type *> ( address ( b_ ) ) = free;
+        free                                              = b_;
+    }
+
+    [[nodiscard]] void * address ( size_type b_ ) const noexcept {
+        return storage[ b_ >> slab_shift ] + std::size_t{ b_ & slab_mask } * block_size;
+    }
+
+    // The number of blocks ever handed out, free or not.
+    [[nodiscard]] size_type capacity ( ) const noexcept { return m_capacity; }
+
+    private:
+    slabs storage;
+    size_type free       = nil;
+    size_type m_capacity = 0;
+};
+
+// The heap layout, every node is allocated on its own (from a size-class pool) and
+// given back as soon as it's released, wherever it is.
+template<typename T, typename S>
+struct heap_vector {
+
+    static_assert ( alignof ( T ) <= 16, "over-aligned types are not supported" );
+
+    using value_type      = T;
+    using size_type       = S;
+    using difference_type = std::make_signed_t<size_type>;
+
+    using pointer         = value_type *;
+    using const_pointer   = value_type const *;
+    using reference       = value_type &;
+    using const_reference = value_type const &;
+
+    private:
+    using pool = size_class_pool<size_class ( sizeof ( value_type ) ), size_type>;
+    using bits = mi_vector<std::uint64_t, size_type>;
+
+    template<typename Container, typename Value>
+    struct heap_iterator {
+
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = std::remove_const_t<Value>;
+        using difference_type   = typename heap_vector::difference_type;
+        using pointer           = Value *;
+        using reference         = Value &;
+
+        heap_iterator ( ) noexcept = default;
+        heap_iterator ( Container * c_, size_type i_ ) noexcept : container{ c_ }, index{ i_ } { skip ( ); }
+
+        [[nodiscard]] reference operator* ( ) const noexcept { return ( *container )[ index ]; }
+        [[nodiscard]] pointer operator-> ( ) const noexcept { return std::addressof ( ( *container )[ index ] ); }
+
+        heap_iterator & operator++ ( ) noexcept {
+            ++index;
+            skip ( );
+            return *this;
+        }
+        heap_iterator operator++ ( int ) noexcept {
+            heap_iterator tmp = *this;
+            ++*this;
+            return tmp;
+        }
+
+        [[nodiscard]] bool operator== ( heap_iterator const & r_ ) const noexcept { return index == r_.index; }
+        [[nodiscard]] bool operator!= ( heap_iterator const & r_ ) const noexcept { return index != r_.index; }
+
+        private:
+        // Advance past free blocks.
+        void skip ( ) noexcept {
+            while ( index < container->nodes.capacity ( ) and not container->is_live ( index ) )
+                ++index;
+        }
+
+        Container * container = nullptr;
+        size_type index       = 0;
+    };
+
+    public:
+    using iterator               = heap_iterator<heap_vector, value_type>;
+    using const_iterator         = heap_iterator<heap_vector const, value_type const>;
+    using reverse_iterator       = void; // Not supported.
+    using const_reverse_iterator = void;
+
+    heap_vector ( ) noexcept = default;
+    heap_vector ( heap_vector const & ) = delete;
+    heap_vector ( heap_vector && o_ ) noexcept { swap ( o_ ); }
+
+    ~heap_vector ( ) noexcept {
+        for ( size_type i = 0; i < nodes.capacity ( ); ++i )
+            if ( is_live ( i ) )
+                std::destroy_at ( &( *this )[ i ] );
+    }
+
+    heap_vector & operator= ( heap_vector const & ) = delete;
+    heap_vector & operator= ( heap_vector && o_ ) noexcept {
+        swap ( o_ );
+        return *this;
+    }
+
+    void swap ( heap_vector & o_ ) noexcept {
+        nodes.swap ( o_.nodes );
+        std::swap ( live, o_.live );
+        std::swap ( m_size, o_.m_size );
+    }
+
+    // A heap node has no relation to the stack it's pushed on.
+    template<typename... Args>
+    [[nodiscard]] size_type emplace_segment ( Args &&... args_ ) {
+        size_type const i = nodes.allocate ( );
+        new ( nodes.address ( i ) ) value_type{ std::forward<Args> ( args_ )... };
+        if ( ( i >> 6 ) == live.size ( ) )
+            live.push_back ( 0 );
+        live[ i >> 6 ] |= std::uint64_t{ 1 } << ( i & 63 );
+        ++m_size;
+        return i;
+    }
+    template<typename... Args>
+    [[nodiscard]] size_type emplace_on ( size_type, Args &&... args_ ) {
+        return emplace_segment ( std::forward<Args> ( args_ )... );
+    }
+
+    void release ( size_type n_ ) noexcept {
+        std::destroy_at ( &( *this )[ n_ ] );
+        live[ n_ >> 6 ] &= ~( std::uint64_t{ 1 } << ( n_ & 63 ) );
+        nodes.deallocate ( n_ );
+        --m_size;
+    }
+
+    [[nodiscard]] reference operator[] ( size_type i_ ) noexcept {
+        return *std::launder ( static_cast<pointer> ( nodes.address ( i_ ) ) );
+    }
+    [[nodiscard]] const_reference operator[] ( size_type i_ ) const noexcept {
+        return *std::launder ( static_cast<const_pointer> ( nodes.address ( i_ ) ) );
+    }
+
+    // The number of (live) elements.
+    [[nodiscard]] size_type size ( ) const noexcept { return m_size; }
+    [[nodiscard]] bool empty ( ) const noexcept { return not m_size; }
+
+    [[nodiscard]] iterator begin ( ) noexcept { return { this, 0 }; }
+    [[nodiscard]] const_iterator begin ( ) const noexcept { return { this, 0 }; }
+    [[nodiscard]] iterator end ( ) noexcept { return { this, nodes.capacity ( ) }; }
+    [[nodiscard]] const_iterator end ( ) const noexcept { return { this, nodes.capacity ( ) }; }
+
+    private:
+    [[nodiscard]] bool is_live ( size_type i_ ) const noexcept { return ( live[ i_ >> 6 ] >> ( i_ & 63 ) ) & 1; }
+
+    pool nodes;
+    bits live;
+    size_type m_size = 0;
+};
+
+// An open addressing (linear probing) hash set of indices. The set doesn't know what the
+// indices refer to, the (mixed) hash of an index is stored next to it and the caller
+// supplies the equality test on lookup.
+template<typename S>
+struct index_hash_set {
+
+    using size_type = S;
+
+    static constexpr size_type nil = static_cast<size_type> ( -1 );
+
+    // Returns the index with hash hash_ for which equal_ ( index ) holds, or nil.
+    template<typename Equal>
+    [[nodiscard]] size_type find ( std::uint64_t hash_, Equal && equal_ ) const {
+        if ( slots.empty ( ) )
+            return nil;
+        std::uint64_t const h = mix ( hash_ );
+        for ( std::size_t s = static_cast<std::size_t> ( h ) & mask ( );; s = ( s + 1 ) & mask ( ) ) {
+            slot_type const & e = slots[ s ];
+            if ( nil == e.index )
+                return nil;
+            if ( h == e.hash and equal_ ( e.index ) )
+                return e.index;
+        }
+    }
+
+    void insert ( std::uint64_t hash_, size_type i_ ) {
+        if ( 2 * ( std::size_t{ count } + 1 ) > slots.size ( ) )
+            grow ( );
+        place ( slot_type{ mix ( hash_ ), i_ } );
+        ++count;
+    }
+
+    // Erases index i_ (which must be in the set, with hash hash_), the entries that follow it
+    // in the probe sequence are shifted back, no tombstones are left.
+    void erase ( std::uint64_t hash_, size_type i_ ) noexcept {
+        std::size_t s = static_cast<std::size_t> ( mix ( hash_ ) ) & mask ( );
+        while ( i_ != slots[ s ].index )
+            s = ( s + 1 ) & mask ( );
+        for ( std::size_t n = ( s + 1 ) & mask ( ); nil != slots[ n ].index; n = ( n + 1 ) & mask ( ) ) {
+            std::size_t const home = static_cast<std::size_t> ( slots[ n ].hash ) & mask ( );
+            if ( ( ( n - home ) & mask ( ) ) >= ( ( n - s ) & mask ( ) ) ) {
+                slots[ s ] = slots[ n ];
+                s          = n;
+            }
+        }
+        slots[ s ] = slot_type{ };
+        --count;
+    }
+
+    void clear ( ) noexcept {
+        slots.clear ( );
+        count = 0;
+    }
+
+    [[nodiscard]] size_type size ( ) const noexcept { return count; }
+
+    private:
+    struct slot_type {
+        std::uint64_t hash = 0;
+        size_type index    = nil;
+    };
+
+    // The slots outnumber the indices, their positions take a std::size_t.
+    using slots_type = mi_vector<slot_type, std::size_t>;
+
+    // The finalizer of murmur3, std::hash of an integer is (often) the identity.
+    [[nodiscard]] static constexpr std::uint64_t mix ( std::uint64_t h_ ) noexcept {
+        h_ ^= h_ >> 33;
+        h_ *= 0xff51'afd7'ed55'8ccdull;
+        h_ ^= h_ >> 33;
+        h_ *= 0xc4ce'b9fe'1a85'ec53ull;
+        return h_ ^ ( h_ >> 33 );
+    }
+
+    [[nodiscard]] std::size_t mask ( ) const noexcept { return slots.size ( ) - 1; }
+
+    void place ( slot_type const & e_ ) noexcept {
+        std::size_t s = static_cast<std::size_t> ( e_.hash ) & mask ( );
+        while ( nil != slots[ s ].index )
+            s = ( s + 1 ) & mask ( );
+        slots[ s ] = e_;
+    }
+
+    void grow ( ) {
+        slots_type old ( slots.empty ( ) ? std::size_t{ 16 } : 2 * slots.size ( ), slot_type{ } );
+        std::swap ( slots, old );
+        for ( slot_type const & e : old )
+            if ( nil != e.index )
+                place ( e );
+    }
+
+    slots_type slots;
+    size_type count = 0;
+};
+
+// Storage policies of spaghetti_stack are 'template<typename T, typename S>'. A vector-like
+// storage (mi_vector, mi_chunked_vector) interleaves all stacks in one arena (C), a
+// segmented storage places nodes itself, according to the stack they're pushed on
+// (mi_cactus_vector, B) or one by one on the heap (mi_heap_vector, A).
+template<typename T, typename S>
+using mi_chunked_vector = chunked_vector<T, S>;
+template<typename T, typename S>
+using mi_cactus_vector = cactus_vector<T, S>;
+template<typename T, typename S>
+using mi_heap_vector = heap_vector<T, S>;
+
+template<typename Storage>
+inline constexpr bool is_segmented_storage_v =
+    requires ( Storage & s_, typename Storage::size_type n_ ) { s_.release ( n_ ); };
@@ -94,163 +94,7 @@ PROPERTY ( warnings, w3, w0, w1, w2, w3, w4 )
     G4 = {h}
 */
 
-#define USE_MIMALLOC_LTO 1
-
-#include <pector/malloc_allocator.h>
-#include <pector/mimalloc_allocator.h>
-#include <pector/pector.h>
-
-#include <memory>
-#include <type_traits> // true_type
-#include <memory>
-
-template<class T>
-struct xmi_stl_allocator : public std::allocator_traits<xmi_stl_allocator<T>> {
-
-    using value_type = typename std::allocator_traits<xmi_stl_allocator<T>>::value_type;
-
-    using propagate_on_container_copy_assignment = std::true_type;
-    using propagate_on_container_move_assignment = std::true_type;
-    using propagate_on_container_swap            = std::true_type;
-    using is_always_equal                        = std::true_type;
-
-    xmi_stl_allocator ( ) mi_attr_noexcept {}
-    xmi_stl_allocator ( const xmi_stl_allocator & ) mi_attr_noexcept {}
-    template<class U>
-    xmi_stl_allocator ( const xmi_stl_allocator<U> & ) mi_attr_noexcept {}
-
-    void deallocate ( T * p, size_t /* count */ ) { mi_free ( p ); }
-    T * allocate ( size_t count ) { return ( T * ) mi_new_n ( count, sizeof ( T ) ); }
-};
-
-template<class T1, class T2>
-bool operator== ( const xmi_stl_allocator<T1> &, const xmi_stl_allocator<T2> & ) mi_attr_noexcept {
-    return true;
-}
-template<class T1, class T2>
-bool operator!= ( const xmi_stl_allocator<T1> &, const xmi_stl_allocator<T2> & ) mi_attr_noexcept {
-    return false;
-}
-
-template<typename T, typename S>
-using mi_vector = pt::pector<T, xmi_stl_allocator<T>, S, pt::default_recommended_size, false>;
-
-template<typename ValueType, typename SizeType>
-struct spaghetti_stack {
-
-    using value_type      = ValueType;
-    using size_type       = SizeType;
-    using difference_type = size_type;
-
-    private:
-    struct spaghetti_type {
-        using value_type = ValueType;
-        size_type prev   = 0;
-        value_type value = { };
-    };
-
-    struct segment_type {
-        size_type prev_tail = 0, tail = 0;
-    };
-
-    struct list_type {
-        size_type index = -1;
-        segment_type block;
-    };
-
-    using spaghetti = mi_vector<spaghetti_type, size_type>;
-    using segment   = mi_vector<segment_type, size_type>;
-    using list      = mi_vector<list_type, size_type>;
-
-    public:
-    using iterator               = typename spaghetti::iterator;
-    using const_iterator         = typename spaghetti::const_iterator;
-    using reverse_iterator       = typename spaghetti::reverse_iterator;
-    using const_reverse_iterator = typename spaghetti::const_reverse_iterator;
-
-    using pointer         = value_type *;
-    using const_pointer   = value_type const *;
-    using reference       = value_type &;
-    using const_reference = value_type const &;
-    using rv_reference    = value_type &&;
-
-    // Emplace/Pop.
-
-    public:
-    template<typename... Args>
-    [[maybe_unused]] reference emplace ( size_type i_, Args &&... args_ ) {
-        validate_tail ( i_ );
-        stack.emplace_back ( { std::exchange ( frame[ i_ ].tail, tail_index ( ) ), std::forward<Args> ( args_ )... } );
-    }
-    [[maybe_unused]] reference push ( size_type i_, const_reference v_ ) { return emplace ( i_, value_type{ v_ } ); }
-
-    // Create new segment with the object created in-place at it's root. Returns a pair,
-    // a reference to the stacked value and the index of the 'new' stack.
-    template<typename... Args>
-    [[maybe_unused]] sax::pair<reference, size_type> notch_emplace ( Args &&... args_ ) {
-        if ( free.empty ( ) ) {
-            size_type i = frame.size ( );
-            return { stack.emplace_back ( { frame.emplace_back ( i - 1, i ), std::forward<Args> ( args_ )... } ), i };
-        }
-        else {
-            size_type i = pop_free ( ).index;
-            return { stack.emplace_back ( { frame.emplace ( frame.begin ( ) + i, i - 1, i ), std::forward<Args> ( args_ )... } ),
-                     i };
-        }
-    }
-    [[maybe_unused]] sax::pair<reference, size_type> notch_push ( const_reference v_ ) {
-        return notch_emplace ( value_type{ v_ } );
-    }
-
-    void remove_stack ( size_type i_ ) {
-        segment_type & f     = frame[ i_ ];
-        stack[ f.tail ].prev = free.push_back ( i_ );
-    }
-
-    [[nodiscard]] size_type find_child ( size_type ) const noexcept {}
-
-    [[maybe_unused]] value_type pop ( size_type i_ ) noexcept {
-        assert ( tail_index ( ) );
-        if ( segment_type & f = frame[ i_ ]; size_type{ 1 } == ( f.tail - f.prev_tail ) ) {
-            stack[ f.tail + 1 ].prev = f.prev_tail;
-            free.push_back ( i_, f );
-            return stack[ f.tail ].value;
-        }
-        else {
-            return stack[ f.tail-- ].value;
-        }
-    }
-
-    [[maybe_unused]] value_type pop ( ) noexcept {
-        assert ( tail_index ( ) );
-        pop_back_after_exit pop_back ( stack );
-        frame[ 0 ] = stack.back ( ).prev;
-        return stack.back ( ).value;
-    }
-
-    // Returns the number of spaghetti-stacks.
-    [[nodiscard]] size_type size ( ) const noexcept { return static_cast<size_type> ( frame.size ( ) ); }
-    [[nodiscard]] size_type tail_index ( ) const noexcept { return static_cast<size_type> ( stack.size ( ) ); }
-
-    [[nodiscard]] bool validate_tail ( size_type i_ ) const noexcept { assert ( 0 <= i_ and i_ < frame.size ( ) ); }
-
-    template<typename VectorLike>
-    struct pop_back_after_exit final {
-        pop_back_after_exit ( VectorLike & ptr_ ) noexcept : object{ ptr_ } {}
-        ~pop_back_after_exit ( ) noexcept { object.pop_back ( ); }
-        VectorLike & object;
-    };
-
-    [[nodiscard]] size_type pop_free ( ) noexcept {
-        assert ( free.size ( ) );
-        pop_back_after_exit pop_back ( free );
-        return free.back ( ).index;
-    }
-
-    spaghetti stack;
-    segment frame = [] { return segment{ }; }( );
-    list free;
-};
+#include "spaghetti_stack.hpp"
 
 int main ( ) {
 
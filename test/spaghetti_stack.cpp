@@ -0,0 +1,634 @@
+// MIT License
+//
+// Copyright (c) 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Rollback, compaction and merge of a spaghetti_stack, checked against the paths of its
+// stacks: the values, the depths (and the jumps, through ancestor_at) and the free lists of
+// frames and of dead node slots. The storages, the SoA layout and the hash-consed DAG, bulk
+// loading, widening and move-only values. The queries of a spaghetti_stack_view, against
+// those of the spaghetti_stack its image was taken of. And the structures built on, or next
+// to, the spaghetti_stack: the concurrent spaghetti_stack, the fork-join pool, the coroutine
+// frame allocator, the disjoint sets and the components of an edge file.
+
+#define CATCH_CONFIG_MAIN
+
+#include <cstdint>
+#include <cstdlib>
+
+#include <atomic>
+#include <coroutine>
+#include <execution>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "detail/catch.hpp"
+
+#include "concurrent_disjoint_set.hpp"
+#include "concurrent_spaghetti_stack.hpp"
+#include "coroutine_frame_allocator.hpp"
+#include "disjoint_set.hpp"
+#include "edge_file.hpp"
+#include "fork_join.hpp"
+#include "spaghetti_stack.hpp"
+#include "spaghetti_stack_view.hpp"
+
+using stack_type      = spaghetti_stack<int, std::uint32_t>;
+using size_type       = stack_type::size_type;
+using frame_size_type = stack_type::frame_size_type;
+
+using paths = std::map<frame_size_type, std::vector<int>>; // The values on the path of a stack, tail first.
+
+namespace {
+
+template<typename Stack>
+[[nodiscard]] paths collect ( Stack const & s_, std::set<frame_size_type> const & live_ ) {
+    paths p;
+    for ( frame_size_type f : live_ )
+        for ( int v : s_.path ( f ) )
+            p[ f ].push_back ( v );
+    return p;
+}
+
+// The depths of the nodes on the paths match their distance to the root, and every node
+// reaches each of its ancestors through ancestor_at. Returns the number of distinct nodes.
+template<typename Stack>
+[[nodiscard]] std::size_t check_depths ( Stack const & s_, std::set<frame_size_type> const & live_ ) {
+    std::set<size_type> nodes;
+    for ( frame_size_type f : live_ ) {
+        std::vector<size_type> path;
+        for ( size_type n = s_.tail ( f ); Stack::nil != n; n = s_.prev ( n ) )
+            path.push_back ( n );
+        REQUIRE ( s_.stack_depth ( f ) == path.size ( ) );
+        for ( std::size_t i = 0; i < path.size ( ); ++i ) {
+            size_type const d = static_cast<size_type> ( path.size ( ) - 1 - i );
+            REQUIRE ( s_.depth ( path[ i ] ) == d );
+            REQUIRE ( s_.ancestor_at ( path.front ( ), d ) == path[ i ] );
+        }
+        nodes.insert ( path.begin ( ), path.end ( ) );
+    }
+    return nodes.size ( );
+}
+
+// Random pushes, forks, notches, pops and removals on the stacks in live_.
+template<typename Stack>
+void mutate ( Stack & s_, std::set<frame_size_type> & live_, std::mt19937 & rng_, int steps_ ) {
+    for ( int step = 0; step < steps_; ++step ) {
+        std::vector<frame_size_type> const l ( live_.begin ( ), live_.end ( ) );
+        frame_size_type const f = l[ rng_ ( ) % l.size ( ) ];
+        switch ( rng_ ( ) % 8 ) {
+            case 0:
+            case 1:
+            case 2: s_.push ( f, step ); break;
+            case 3: live_.insert ( s_.fork_push ( f, step ).second ); break;
+            case 4: live_.insert ( s_.notch_push ( step ).second ); break;
+            case 5:
+            case 6:
+                if ( s_.frame_size ( f ) > 1 )
+                    ( void ) s_.pop ( f );
+                break;
+            default:
+                if ( live_.size ( ) > 1 ) {
+                    s_.remove_stack ( f );
+                    live_.erase ( f );
+                }
+        }
+    }
+}
+
+} // namespace
+
+TEST_CASE ( "rollback restores paths, depths and free lists", "[checkpoint]" ) {
+    stack_type s;
+    std::set<frame_size_type> live;
+    frame_size_type const a = s.notch_push ( 0 ).second;
+    live.insert ( a );
+    for ( int v = 1; v < 10; ++v )
+        s.push ( a, v );
+    live.insert ( s.fork_push ( a, 10 ).second );
+    // A free frame, and dead node slots (not on top of the arena).
+    frame_size_type const d = s.notch_push ( 20 ).second;
+    s.push ( d, 21 );
+    s.push ( a, 11 );
+    s.remove_stack ( d );
+    size_type const nodes = s.tail_index ( ), count = s.node_count ( );
+    REQUIRE ( count == nodes - 2 );
+
+    paths const before = collect ( s, live );
+    std::mt19937 rng ( 1 );
+    std::set<frame_size_type> changed = live;
+    stack_type::checkpoint_type const c = s.checkpoint ( );
+    mutate ( s, changed, rng, 500 );
+    s.rollback ( c );
+
+    REQUIRE ( collect ( s, live ) == before );
+    REQUIRE ( check_depths ( s, live ) == count );
+    REQUIRE ( s.node_count ( ) == count );
+    REQUIRE ( s.tail_index ( ) == nodes );
+    // The free frame and the dead slots are reused, as before the checkpoint.
+    frame_size_type const e = s.notch_push ( 30 ).second;
+    REQUIRE ( e == d );
+    s.push ( e, 31 );
+    REQUIRE ( s.tail_index ( ) == nodes );
+}
+
+TEST_CASE ( "rollback restores the values popped under a checkpoint", "[checkpoint]" ) {
+    using string_stack = spaghetti_stack<std::string, std::uint32_t>;
+    string_stack s;
+    std::string const a ( 64, 'a' ), b ( 64, 'b' ); // Not in the small buffer, a move empties them.
+    string_stack::frame_size_type const f = s.notch_push ( a ).second;
+    s.push ( f, b );
+    string_stack::checkpoint_type const c = s.checkpoint ( );
+    REQUIRE ( s.pop ( f ) == b );
+    s.push ( f, "c" );
+    REQUIRE ( s.visit_pop ( f, [] ( std::string & v_ ) { return std::move ( v_ ); } ) == "c" );
+    s.rollback ( c );
+    std::vector<std::string> path;
+    for ( std::string const & v : s.path ( f ) )
+        path.push_back ( v );
+    REQUIRE ( path == std::vector<std::string>{ b, a } );
+}
+
+TEST_CASE ( "nested checkpoints roll back and commit in order", "[checkpoint]" ) {
+    stack_type s;
+    std::set<frame_size_type> live;
+    live.insert ( s.notch_push ( 0 ).second );
+    std::mt19937 rng ( 2 );
+    mutate ( s, live, rng, 200 );
+
+    paths const outer_paths = collect ( s, live );
+    size_type const outer_count = s.node_count ( );
+    stack_type::checkpoint_type const outer = s.checkpoint ( );
+    std::set<frame_size_type> inner_live = live;
+    mutate ( s, inner_live, rng, 200 );
+    paths const inner_paths = collect ( s, inner_live );
+    stack_type::checkpoint_type const inner = s.checkpoint ( );
+    std::set<frame_size_type> changed = inner_live;
+    mutate ( s, changed, rng, 200 );
+    s.rollback ( inner );
+    REQUIRE ( collect ( s, inner_live ) == inner_paths );
+    REQUIRE ( check_depths ( s, inner_live ) == s.node_count ( ) );
+
+    stack_type::checkpoint_type const again = s.checkpoint ( );
+    changed                                 = inner_live;
+    mutate ( s, changed, rng, 200 );
+    s.commit ( again );
+    s.rollback ( outer );
+    REQUIRE ( collect ( s, live ) == outer_paths );
+    REQUIRE ( check_depths ( s, live ) == outer_count );
+    REQUIRE ( s.node_count ( ) == outer_count );
+}
+
+TEST_CASE ( "commit reclaims the nodes released below the mark", "[checkpoint]" ) {
+    stack_type s;
+    frame_size_type const a = s.notch_push ( 0 ).second;
+    for ( int v = 1; v <= 10; ++v )
+        s.push ( a, v );
+    stack_type::checkpoint_type const c = s.checkpoint ( );
+    for ( int k = 0; k < 5; ++k )
+        ( void ) s.pop ( a );
+    REQUIRE ( s.node_count ( ) == 6 );
+    s.commit ( c );
+    for ( int v = 6; v <= 10; ++v )
+        s.push ( a, v );
+    REQUIRE ( s.tail_index ( ) == 11 );
+    REQUIRE ( s.node_count ( ) == 11 );
+    REQUIRE ( s.stack_depth ( a ) == 11 );
+}
+
+TEST_CASE ( "compaction drops the dead nodes and keeps paths, depths and free frames", "[compaction]" ) {
+    stack_type s;
+    std::set<frame_size_type> live;
+    live.insert ( s.notch_push ( 0 ).second );
+    std::mt19937 rng ( 3 );
+    mutate ( s, live, rng, 2000 );
+    frame_size_type const removed = *live.rbegin ( );
+    s.remove_stack ( removed );
+    live.erase ( removed );
+    REQUIRE ( s.node_count ( ) < s.tail_index ( ) );
+
+    paths const before = collect ( s, live );
+    std::map<frame_size_type, size_type> tails;
+    for ( frame_size_type f : live )
+        tails[ f ] = s.tail ( f );
+    size_type const count = s.node_count ( );
+
+    SECTION ( "in one go" ) {
+        stack_type::index_map const map = s.compact ( );
+        for ( auto const & [ f, t ] : tails )
+            REQUIRE ( map[ t ] == s.tail ( f ) );
+    }
+    SECTION ( "in steps" ) {
+        stack_type::compaction c = s.compactor ( );
+        while ( not c.step ( 7 ) )
+            REQUIRE ( collect ( s, live ) == before );
+    }
+
+    REQUIRE ( collect ( s, live ) == before );
+    REQUIRE ( check_depths ( s, live ) == count );
+    REQUIRE ( s.node_count ( ) == count );
+    REQUIRE ( s.tail_index ( ) == count );
+    // The free frames survive, there are no dead node slots.
+    REQUIRE ( s.notch_push ( -1 ).second == removed );
+    REQUIRE ( s.tail_index ( ) == count + 1 );
+}
+
+TEST_CASE ( "merge attaches the stacks forked off the shared prefix", "[merge]" ) {
+    using local_type = local_spaghetti_stack<stack_type>;
+    stack_type shared;
+    frame_size_type const a = shared.notch_push ( 0 ).second;
+    for ( int v = 1; v < 5; ++v )
+        shared.push ( a, v );
+    size_type const branch_point = shared.tail ( a );
+
+    local_type & local = local_type::local ( );
+    frame_size_type const f = local.fork_emplace ( branch_point, 100 ).second;
+    for ( int v = 101; v < 104; ++v )
+        local.stack ( ).push ( f, v );
+    frame_size_type const g = local.fork_emplace ( stack_type::nil, 200 ).second;
+    local.stack ( ).push ( g, 201 );
+    frame_size_type const h = local.fork_emplace ( stack_type::nil, 300 ).second;
+    local.stack ( ).remove_stack ( h );
+
+    std::mutex mutex;
+    sax::pair<size_type, frame_size_type> const offsets = local.merge_into ( shared, mutex );
+    REQUIRE ( local.stack ( ).size ( ) == 0 );
+    frame_size_type const mf = static_cast<frame_size_type> ( f + offsets.second );
+    frame_size_type const mg = static_cast<frame_size_type> ( g + offsets.second );
+    std::set<frame_size_type> const live{ a, mf, mg };
+
+    paths const merged = collect ( shared, live );
+    REQUIRE ( merged.at ( a ) == std::vector<int>{ 4, 3, 2, 1, 0 } );
+    REQUIRE ( merged.at ( mf ) == std::vector<int>{ 103, 102, 101, 100, 4, 3, 2, 1, 0 } );
+    REQUIRE ( merged.at ( mg ) == std::vector<int>{ 201, 200 } );
+    REQUIRE ( check_depths ( shared, live ) == 11 );
+    REQUIRE ( shared.node_count ( ) == 11 );
+    REQUIRE ( shared.frame_size ( mf ) == 4 );
+    REQUIRE ( shared.is_ancestor ( branch_point, shared.tail ( mf ) ) );
+    REQUIRE ( shared.lca ( shared.tail ( mf ), shared.tail ( a ) ) == branch_point );
+    REQUIRE ( shared.lca ( shared.tail ( mf ), shared.tail ( mg ) ) == stack_type::nil );
+    // The frame freed in the local instance is reused first.
+    REQUIRE ( shared.notch_push ( 400 ).second == h + offsets.second );
+}
+
+TEST_CASE ( "a view answers the queries of the spaghetti_stack it's an image of", "[view]" ) {
+    stack_type s;
+    std::set<frame_size_type> live;
+    live.insert ( s.notch_push ( 0 ).second );
+    std::mt19937 rng ( 4 );
+    mutate ( s, live, rng, 2000 );
+    std::filesystem::path const file = std::filesystem::temp_directory_path ( ) / "spaghetti_stack_test.image";
+    save_image ( s, file );
+    {
+        spaghetti_stack_view<int, std::uint32_t> const v ( file );
+        REQUIRE ( v.node_count ( ) == s.node_count ( ) );
+        for ( frame_size_type f : live ) {
+            size_type const t = s.tail ( f );
+            REQUIRE ( v.stack_depth ( f ) == s.stack_depth ( f ) );
+            REQUIRE ( v.frame_size ( f ) == s.frame_size ( f ) );
+            std::vector<int> path;
+            for ( int x : v.path ( f ) )
+                path.push_back ( x );
+            REQUIRE ( path == collect ( s, { f } ).at ( f ) );
+            for ( size_type k = 0; k <= s.depth ( t ); k += 3 )
+                REQUIRE ( v.level_ancestor ( t, k ) == s.level_ancestor ( t, k ) );
+            for ( frame_size_type g : live )
+                REQUIRE ( v.lca ( t, s.tail ( g ) ) == s.lca ( t, s.tail ( g ) ) );
+            size_type const r = s.ancestor_at ( t, 0 );
+            REQUIRE ( std::vector<size_type> ( v.children ( r ).begin ( ), v.children ( r ).end ( ) ) ==
+                      std::vector<size_type> ( s.children ( r ).begin ( ), s.children ( r ).end ( ) ) );
+        }
+    }
+    // An image of which the offsets disagree with its sizes is rejected.
+    {
+        std::fstream io ( file, std::ios::binary | std::ios::in | std::ios::out );
+        spaghetti_image::header_type h;
+        io.read ( reinterpret_cast<char *> ( &h ), sizeof ( h ) );
+        h.node_offset += spaghetti_image::alignment;
+        io.seekp ( 0 );
+        io.write ( reinterpret_cast<char const *> ( &h ), sizeof ( h ) );
+    }
+    REQUIRE_THROWS_AS ( ( spaghetti_stack_view<int, std::uint32_t> ( file ) ), std::runtime_error );
+    std::filesystem::remove ( file );
+}
+
+TEMPLATE_TEST_CASE ( "the storages and the SoA layout keep the stacks of the spaghetti layout", "[storage]",
+                     ( stable_spaghetti_stack<int, std::uint32_t> ), ( cactus_stack<int, std::uint32_t> ),
+                     ( heap_stack<int, std::uint32_t> ), ( soa_spaghetti_stack<int, std::uint32_t> ) ) {
+    stack_type s;
+    TestType t;
+    std::set<frame_size_type> live_s, live_t;
+    live_s.insert ( s.notch_push ( 0 ).second );
+    live_t.insert ( t.notch_push ( 0 ).second );
+    std::mt19937 rng_s ( 5 ), rng_t ( 5 );
+    mutate ( s, live_s, rng_s, 3000 );
+    mutate ( t, live_t, rng_t, 3000 );
+    REQUIRE ( live_t == live_s );
+    REQUIRE ( collect ( t, live_t ) == collect ( s, live_s ) );
+    REQUIRE ( check_depths ( t, live_t ) == t.node_count ( ) );
+    REQUIRE ( t.node_count ( ) == s.node_count ( ) );
+}
+
+TEST_CASE ( "a chunked storage never moves a node", "[storage]" ) {
+    stable_spaghetti_stack<int, std::uint32_t> s;
+    auto const root            = s.notch_push ( -1 );
+    int const * const address = &root.first;
+    for ( int v = 0; v < 100'000; ++v )
+        s.push ( root.second, v );
+    REQUIRE ( &s.value ( s.ancestor_at ( s.tail ( root.second ), 0 ) ) == address );
+    REQUIRE ( *address == -1 );
+}
+
+TEST_CASE ( "a hash-consed spaghetti_stack shares equal paths", "[dedup]" ) {
+    dag_spaghetti_stack<int, std::uint32_t> s;
+    auto const a = s.notch_push ( 0 ).second;
+    s.push ( a, 1 );
+    s.push ( a, 2 );
+    auto const b = s.fork_push ( a, 3 ).second;
+    auto const c = s.fork_push ( a, 3 ).second;
+    REQUIRE ( s.tail ( b ) == s.tail ( c ) );
+    REQUIRE ( s.node_count ( ) == 4 );
+    auto const d = s.notch_push ( 0 ).second;
+    s.push ( d, 1 );
+    s.push ( d, 2 );
+    REQUIRE ( s.tail ( d ) == s.tail ( a ) );
+    REQUIRE ( s.node_count ( ) == 4 );
+    s.push ( d, 4 );
+    REQUIRE ( s.node_count ( ) == 5 );
+    REQUIRE ( collect ( s, { b, d } ) == paths{ { b, { 3, 2, 1, 0 } }, { d, { 4, 2, 1, 0 } } } );
+}
+
+TEST_CASE ( "bulk loads build the stacks of the forest", "[bulk]" ) {
+    // The stacks 0 1 2, 0 3 4 5 and 0 3 4 6, root first.
+    std::vector<size_type> const parents{ stack_type::nil, 0, 1, 0, 3, 4, 4 }, depths{ 0, 1, 2, 1, 2, 3, 3 };
+    std::vector<int> const values{ 0, 1, 2, 3, 4, 5, 6 };
+    paths const expected{ { 0, { 2, 1, 0 } }, { 1, { 5, 4, 3, 0 } }, { 2, { 6, 4, 3, 0 } } };
+    std::set<frame_size_type> const live{ 0, 1, 2 };
+    stack_type s;
+    SECTION ( "from a parent array" ) { s.bulk_load ( parents, values ); }
+    SECTION ( "from a pre-order depth stream" ) { s.bulk_load_preorder ( depths, values ); }
+    SECTION ( "from a pre-order depth stream, under an execution policy" ) {
+        s.bulk_load_preorder ( std::execution::seq, depths, values );
+    }
+    REQUIRE ( s.size ( ) == 3 );
+    REQUIRE ( collect ( s, live ) == expected );
+    REQUIRE ( check_depths ( s, live ) == values.size ( ) );
+    REQUIRE ( s.frame_size ( 2 ) == 1 );
+    REQUIRE ( s.lca ( s.tail ( 1 ), s.tail ( 2 ) ) == 4 );
+}
+
+TEST_CASE ( "an index overflow throws and widen moves on to wider indices", "[widen]" ) {
+    using narrow_type = spaghetti_stack<int, std::uint8_t>;
+    narrow_type s;
+    auto const f = s.notch_push ( 0 ).second;
+    int v        = 1;
+    REQUIRE_THROWS_AS ( [ & ] { for ( ;; ++v ) s.push ( f, v ); }( ), std::length_error );
+    REQUIRE ( s.stack_depth ( f ) == narrow_type::nil );
+    spaghetti_stack<int, std::uint32_t> w = std::move ( s ).widen<std::uint32_t> ( );
+    w.push ( f, v );
+    REQUIRE ( w.stack_depth ( f ) == narrow_type::nil + 1u );
+    REQUIRE ( w.top ( f ) == v );
+    REQUIRE ( w.ancestor_at ( w.tail ( f ), 0 ) == 0 );
+
+    spaghetti_stack<int, std::uint32_t, mi_vector, false, false, std::uint8_t> frames;
+    REQUIRE_THROWS_AS ( [ & ] { for ( ;; ) ( void ) frames.notch_push ( 0 ); }( ), std::length_error );
+    REQUIRE ( frames.size ( ) == 255 );
+}
+
+TEST_CASE ( "move-only values are popped and visited in place", "[pop]" ) {
+    spaghetti_stack<std::unique_ptr<int>, std::uint32_t> s;
+    auto const f = s.notch_push ( std::make_unique<int> ( 1 ) ).second;
+    s.push ( f, std::make_unique<int> ( 2 ) );
+    std::unique_ptr<int> const p = s.pop ( f );
+    REQUIRE ( *p == 2 );
+    // The root is a branch point, visit_pop leaves its value to the forked stack.
+    auto const g = s.fork_push ( f, std::make_unique<int> ( 3 ) ).second;
+    REQUIRE ( s.visit_pop ( f, [] ( std::unique_ptr<int> const & v_ ) { return *v_; } ) == 1 );
+    REQUIRE ( *s.value ( s.prev ( s.tail ( g ) ) ) == 1 );
+    REQUIRE ( s.node_count ( ) == 2 );
+    s.remove_stack ( g );
+    REQUIRE ( s.node_count ( ) == 0 );
+}
+
+TEST_CASE ( "a concurrent_spaghetti_stack is grown from many threads", "[concurrent]" ) {
+    using concurrent_type = concurrent_spaghetti_stack<int, std::uint32_t>;
+    concurrent_type s;
+    int constexpr threads = 4, pushes = 10'000;
+    auto const root       = s.notch_push ( -1 ).second;
+    std::vector<concurrent_type::size_type> stacks ( threads );
+    std::vector<std::thread> workers;
+    for ( int t = 0; t < threads; ++t )
+        workers.emplace_back ( [ &, t ] {
+            stacks[ t ] = s.fork_push ( root, t * pushes ).second;
+            for ( int v = 1; v < pushes; ++v )
+                s.push ( stacks[ t ], t * pushes + v );
+            static_cast<void> ( s.pop ( stacks[ t ] ) ); // Off the path below, but still in the arena.
+        } );
+    for ( std::thread & w : workers )
+        w.join ( );
+    REQUIRE ( s.size ( ) == threads + 1 );
+    REQUIRE ( s.tail_index ( ) == threads * pushes + 1 );
+    for ( int t = 0; t < threads; ++t ) {
+        REQUIRE ( s.validate_tail ( stacks[ t ] ) );
+        int expected = t * pushes + pushes - 2;
+        for ( auto n = s.tail ( stacks[ t ] ); concurrent_type::nil != n; n = s.prev ( n ), --expected )
+            REQUIRE ( s.value ( n ) == ( expected < t * pushes ? -1 : expected ) );
+    }
+}
+
+namespace {
+
+[[nodiscard]] std::uint64_t fib ( int n_ ) {
+    if ( n_ < 2 )
+        return static_cast<std::uint64_t> ( n_ );
+    std::uint64_t a = 0, b = 0;
+    fork_join_pool::join ( [ & ] { a = fib ( n_ - 1 ); }, [ & ] { b = fib ( n_ - 2 ); } );
+    return a + b;
+}
+
+// The sum of the nodes [ first_, last_ ) of a complete binary tree in heap order, and the
+// deepest fork depth seen.
+[[nodiscard]] std::uint64_t tree_sum ( std::vector<int> const & tree_, std::size_t n_, std::atomic<unsigned> & depth_ ) {
+    if ( n_ >= tree_.size ( ) )
+        return 0;
+    for ( unsigned d = fork_join_pool::depth ( ), m = depth_.load ( ); m < d and not depth_.compare_exchange_weak ( m, d ); )
+        ;
+    std::uint64_t l = 0, r = 0;
+    fork_join_pool::join ( [ & ] { l = tree_sum ( tree_, 2 * n_ + 1, depth_ ); },
+                           [ & ] { r = tree_sum ( tree_, 2 * n_ + 2, depth_ ); } );
+    return static_cast<std::uint64_t> ( tree_[ n_ ] ) + l + r;
+}
+
+} // namespace
+
+TEST_CASE ( "the fork-join pool computes what the serial code computes", "[fork_join]" ) {
+    fork_join_pool pool ( 4 );
+    REQUIRE ( pool.run ( [] { return fib ( 25 ); } ) == 75'025 );
+    std::vector<int> tree ( ( 1 << 14 ) - 1 );
+    std::iota ( tree.begin ( ), tree.end ( ), 1 );
+    std::atomic<unsigned> depth{ 0 };
+    REQUIRE ( pool.run ( [ & ] { return tree_sum ( tree, 0, depth ); } ) == std::uint64_t{ tree.size ( ) } * ( tree.size ( ) + 1 ) / 2 );
+    // The frames of the right children chain up to the root, the deepest leaf is 13 forks down.
+    REQUIRE ( depth.load ( ) == 13 );
+    REQUIRE ( fork_join_pool::depth ( ) == 0 );
+}
+
+namespace {
+
+struct frame_task {
+    struct promise_type : coroutine_frame_promise<> {
+        [[nodiscard]] frame_task get_return_object ( ) noexcept {
+            return { std::coroutine_handle<promise_type>::from_promise ( *this ) };
+        }
+        [[nodiscard]] std::suspend_always initial_suspend ( ) const noexcept { return { }; }
+        [[nodiscard]] std::suspend_always final_suspend ( ) const noexcept { return { }; }
+        void return_void ( ) const noexcept {}
+        void unhandled_exception ( ) const noexcept { std::terminate ( ); }
+    };
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+[[nodiscard]] frame_task leaf ( int & out_, int v_ ) {
+    out_ = v_;
+    co_return;
+}
+
+} // namespace
+
+TEST_CASE ( "coroutine frames are carved out of the frame allocator", "[coroutine]" ) {
+    using allocator_type       = coroutine_frame_allocator<>;
+    allocator_type & allocator = allocator_type::local ( );
+    REQUIRE ( allocator.size ( ) == 0 );
+    int out             = 0;
+    frame_task const a  = leaf ( out, 1 );
+    frame_task const b  = leaf ( out, 2 );
+    REQUIRE ( allocator.size ( ) == 2 );
+    a.handle.resume ( );
+    b.handle.resume ( );
+    REQUIRE ( out == 2 );
+    // The frame of b is forked off that of a, a is released with it.
+    a.handle.destroy ( );
+    REQUIRE ( allocator.size ( ) == 1 );
+    b.handle.destroy ( );
+    REQUIRE ( allocator.size ( ) == 0 );
+    // A frame larger than a slot comes from operator new.
+    void * const p = allocator.allocate ( allocator_type::slot_size + 1 );
+    REQUIRE ( allocator.size ( ) == 0 );
+    allocator_type::deallocate ( p, allocator_type::slot_size + 1 );
+}
+
+TEST_CASE ( "a dynamic_disjoint_set grows, enumerates its groups and names them", "[disjoint_set]" ) {
+    dynamic_disjoint_set<> s ( 4 );
+    for ( int k = 0; k < 4; ++k )
+        REQUIRE ( s.add_element ( ) == 4u + k );
+    REQUIRE ( s.group_count ( ) == 8 );
+    s.unite ( 0, 5 );
+    s.unite ( 5, 7, "odd" );
+    s.unite ( 2, 3 );
+    REQUIRE ( s.same ( 0, 7 ) );
+    REQUIRE_FALSE ( s.same ( 0, 2 ) );
+    REQUIRE ( s.group_count ( ) == 5 );
+    REQUIRE ( s.group_size ( 7 ) == 3 );
+    std::set<std::uint32_t> const members ( s.members ( 5 ).begin ( ), s.members ( 5 ).end ( ) );
+    REQUIRE ( members == std::set<std::uint32_t>{ 0, 5, 7 } );
+    REQUIRE ( std::string{ s.find_name ( 0 ) } == "odd" );
+    REQUIRE ( std::string{ s.find_name ( 2 ) }.empty ( ) );
+    // The name goes with the group.
+    s.unite ( 2, 0 );
+    REQUIRE ( std::string{ s.find_name ( 3 ) } == "odd" );
+}
+
+TEST_CASE ( "a rollback undoes the unions and namings after a snapshot", "[disjoint_set]" ) {
+    dynamic_disjoint_set<std::uint32_t, true> s ( 6 );
+    s.unite ( 0, 1, "a" );
+    auto const snapshot = s.snapshot ( );
+    s.unite ( 1, 2 );
+    s.unite ( 3, 4, "b" );
+    s.unite ( 4, 0, "c" );
+    static_cast<void> ( s.add_element ( ) );
+    REQUIRE ( s.group_count ( ) == 3 );
+    s.rollback ( snapshot );
+    REQUIRE ( s.size ( ) == 6 );
+    REQUIRE ( s.group_count ( ) == 5 );
+    REQUIRE ( s.same ( 0, 1 ) );
+    REQUIRE_FALSE ( s.same ( 1, 2 ) );
+    REQUIRE_FALSE ( s.same ( 3, 4 ) );
+    REQUIRE ( s.group_size ( 0 ) == 2 );
+    REQUIRE ( std::string{ s.find_name ( 1 ) } == "a" );
+    REQUIRE ( std::string{ s.find_name ( 3 ) }.empty ( ) );
+    REQUIRE ( std::distance ( s.members ( 0 ).begin ( ), s.members ( 0 ).end ( ) ) == 2 );
+}
+
+TEST_CASE ( "a concurrent_disjoint_set is united from many threads", "[disjoint_set]" ) {
+    std::uint32_t constexpr size = 1 << 16;
+    concurrent_disjoint_set<> s ( size );
+    // Thread t links every element to the next one of the same parity, from its own slice.
+    std::vector<std::thread> workers;
+    for ( std::uint32_t t = 0; t < 4; ++t )
+        workers.emplace_back ( [ &, t ] {
+            for ( std::uint32_t x = t * size / 4; x < ( t + 1 ) * size / 4 and x + 2 < size; ++x )
+                s.unite ( x, x + 2 );
+        } );
+    for ( std::thread & w : workers )
+        w.join ( );
+    REQUIRE ( s.same ( 0, size - 2 ) );
+    REQUIRE ( s.same ( 1, size - 1 ) );
+    REQUIRE_FALSE ( s.same ( 0, 1 ) );
+    // The root of a group is its lowest element.
+    REQUIRE ( s.find ( size - 2 ) == 0 );
+    REQUIRE ( s.find ( size - 1 ) == 1 );
+    REQUIRE_FALSE ( s.unite ( 2, 4 ) );
+}
+
+TEST_CASE ( "the components of an edge file", "[edge_file]" ) {
+    std::filesystem::path const file = std::filesystem::temp_directory_path ( ) / "spaghetti_stack_test.edges";
+    std::vector<std::uint32_t> const expected{ 0, 0, 0, 0, 4, 5, 5 };
+    SECTION ( "in text" ) {
+        std::ofstream ( file ) << "# a comment 8 9\n0 1\n2 <-> 3\n\n1,2\n5 6";
+        connected_components<std::uint32_t> const c = edge_file_components<std::uint32_t> ( file, edge_file_format::text, 0, 3 );
+        REQUIRE ( std::vector<std::uint32_t> ( c.label.begin ( ), c.label.end ( ) ) == expected );
+        REQUIRE ( c.count == 3 );
+    }
+    SECTION ( "in binary" ) {
+        std::uint32_t const edges[]{ 0, 1, 2, 3, 1, 2, 5, 6 };
+        std::ofstream ( file, std::ios::binary ).write ( reinterpret_cast<char const *> ( edges ), sizeof ( edges ) );
+        connected_components<std::uint32_t> const c = edge_file_components<std::uint32_t> ( file, edge_file_format::binary, 0, 2 );
+        REQUIRE ( std::vector<std::uint32_t> ( c.label.begin ( ), c.label.end ( ) ) == expected );
+        REQUIRE ( c.count == 3 );
+        REQUIRE_THROWS_AS ( edge_file_components<std::uint32_t> ( file, edge_file_format::binary, 6, 2 ), std::runtime_error );
+    }
+    SECTION ( "in a truncated binary file" ) {
+        std::ofstream ( file, std::ios::binary ) << "12345";
+        REQUIRE_THROWS_AS ( edge_file_components<std::uint32_t> ( file, edge_file_format::binary ), std::runtime_error );
+    }
+    std::filesystem::remove ( file );
+}